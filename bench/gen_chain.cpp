@@ -0,0 +1,114 @@
+// Write a synthetic, deterministic blockchain for offline
+// benchmarks, e.g.:
+//
+//   ./rings_gen_chain -b /tmp/synthetic/lmdb --blocks 10000
+//   ./rings --bc-path /tmp/synthetic/lmdb --read-only --start-height 0
+//
+
+#include "../src/MicroCore.h"
+#include "../src/ChainGenerator.h"
+
+#include "../ext/format.h"
+
+#include <boost/program_options.hpp>
+
+#include <chrono>
+
+using namespace std;
+
+namespace po = boost::program_options;
+
+namespace epee {
+    unsigned int g_test_dbg_lock_sleep = 0;
+}
+
+
+int main(int ac, const char* av[])
+{
+    xmreg::chain_generator_config config;
+
+    po::options_description desc("rings_gen_chain, write synthetic blockchain");
+
+    desc.add_options()
+            ("help,h", "produce help message")
+            ("bc-path,b", po::value<string>()->required(),
+             "path to new lmdb blockchain folder")
+            ("blocks", po::value<uint64_t>(&config.no_of_blocks)
+                     ->default_value(config.no_of_blocks),
+             "number of blocks")
+            ("txs-per-block", po::value<size_t>(&config.txs_per_block)
+                     ->default_value(config.txs_per_block),
+             "number of non-coinbase txs in each block")
+            ("inputs-per-tx", po::value<size_t>(&config.inputs_per_tx)
+                     ->default_value(config.inputs_per_tx),
+             "number of inputs in each tx")
+            ("ring-size", po::value<size_t>(&config.ring_size)
+                     ->default_value(config.ring_size),
+             "number of ring members of each input")
+            ("outputs-per-tx", po::value<size_t>(&config.outputs_per_tx)
+                     ->default_value(config.outputs_per_tx),
+             "number of outputs of each tx")
+            ("seed", po::value<uint64_t>(&config.seed)
+                     ->default_value(config.seed),
+             "seed of the generator, same seed gives the same chain");
+
+    po::variables_map vm;
+
+    try
+    {
+        po::store(po::parse_command_line(ac, av, desc), vm);
+
+        if (vm.count("help"))
+        {
+            cout << desc << endl;
+            return 0;
+        }
+
+        po::notify(vm);
+    }
+    catch (const po::error& e)
+    {
+        cerr << e.what() << "\n" << desc << endl;
+        return 1;
+    }
+
+    string blockchain_path = vm["bc-path"].as<string>();
+
+    fmt::print("Generating {} blocks, {} txs per block, {} inputs per tx, "
+               "ring size {}, {} outputs per tx, seed {}\n",
+               config.no_of_blocks, config.txs_per_block, config.inputs_per_tx,
+               config.ring_size, config.outputs_per_tx, config.seed);
+
+    auto start = chrono::steady_clock::now();
+
+    xmreg::ChainGenerator generator {config};
+
+    if (!generator.generate(blockchain_path))
+    {
+        return 1;
+    }
+
+    double seconds = chrono::duration<double>(
+            chrono::steady_clock::now() - start).count();
+
+    // check that the new chain opens as any other
+    xmreg::MicroCore mcore;
+
+    if (!mcore.init(blockchain_path, true))
+    {
+        cerr << "Cant open generated blockchain: " << blockchain_path << endl;
+        return 1;
+    }
+
+    uint64_t height = mcore.get_db().height();
+
+    fmt::print("Blockchain height: {}, time: {:.3f} s\n", height, seconds);
+
+    if (height > 0)
+    {
+        fmt::print("Top block: {}\n",
+                   mcore.get_db().get_block_hash_from_height(height - 1));
+    }
+
+    return 0;
+}
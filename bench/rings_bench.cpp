@@ -0,0 +1,418 @@
+// Microbenchmarks of ring signature related crypto.
+//
+// Each benchmark is run until it takes at least --min-time seconds.
+// Results are written as JSON to stdout, or to --output file,
+// so that they can be compared between builds and machines.
+//
+
+#include "../src/MicroCore.h"
+#include "../src/PointCache.h"
+
+#include "../ext/format.h"
+
+#include <boost/program_options.hpp>
+
+#include <chrono>
+#include <fstream>
+#include <iostream>
+
+using namespace std;
+
+namespace po = boost::program_options;
+
+using std::chrono::steady_clock;
+
+namespace epee {
+    unsigned int g_test_dbg_lock_sleep = 0;
+}
+
+
+namespace
+{
+
+    struct bench_result
+    {
+        string name;
+        size_t ring_size;
+        uint64_t iterations;
+        double seconds;
+    };
+
+
+    // results of benchmarked calls are added here, so
+    // that the compiler cant remove the calls
+    volatile uint64_t g_sink {0};
+
+
+    /**
+     * Call f in batches of doubling size until
+     * min_time seconds have passed.
+     *
+     * ops_per_call is the number of operations, e.g., rings
+     * checked, done by one call of f, so that batch APIs are
+     * reported per operation as well.
+     */
+    template <typename F>
+    bench_result
+    run_bench(const string& name, size_t ring_size, double min_time, F f,
+              uint64_t ops_per_call = 1)
+    {
+        // warm up, e.g., caches and lazy initialization
+        g_sink += f();
+
+        uint64_t iterations {0};
+        uint64_t batch {1};
+
+        double seconds {0};
+
+        auto start = steady_clock::now();
+
+        while (seconds < min_time)
+        {
+            for (uint64_t i = 0; i < batch; ++i)
+            {
+                g_sink += f();
+            }
+
+            iterations += batch;
+
+            if (batch < (1 << 16))
+            {
+                batch *= 2;
+            }
+
+            seconds = chrono::duration<double>(
+                    steady_clock::now() - start).count();
+        }
+
+        iterations *= ops_per_call;
+
+        cerr << fmt::format("{:<40} ring size {:>3}: {:>12.0f} ns/op\n",
+                            name, ring_size, seconds * 1e9 / iterations);
+
+        return bench_result {name, ring_size, iterations, seconds};
+    }
+
+
+    /**
+     * Random ring with its signature, signed by
+     * the member at real_index
+     */
+    struct ring_fixture
+    {
+        crypto::hash prefix_hash;
+        crypto::key_image image;
+        vector<crypto::public_key> pub_keys;
+        vector<const crypto::public_key*> pub_key_ptrs;
+        vector<crypto::signature> signatures;
+        crypto::secret_key real_sec;
+        size_t real_index;
+
+        explicit ring_fixture(size_t ring_size):
+                pub_keys(ring_size), signatures(ring_size),
+                real_index(ring_size / 2)
+        {
+            crypto::secret_key sec;
+
+            for (size_t i = 0; i < ring_size; ++i)
+            {
+                crypto::generate_keys(pub_keys[i], sec);
+
+                if (i == real_index)
+                {
+                    real_sec = sec;
+                }
+            }
+
+            for (const crypto::public_key& pub_key: pub_keys)
+            {
+                pub_key_ptrs.push_back(&pub_key);
+            }
+
+            crypto::cn_fast_hash(pub_keys.data(),
+                                 pub_keys.size() * sizeof(crypto::public_key),
+                                 prefix_hash);
+
+            crypto::generate_key_image(pub_keys[real_index], real_sec, image);
+
+            crypto::generate_ring_signature(prefix_hash, image, pub_key_ptrs,
+                                            real_sec, real_index,
+                                            signatures.data());
+        }
+    };
+
+
+    /**
+     * Check that crypto::check_ring_signature, MicroCore's single
+     * and batch checks, and PointCache's check give the same,
+     * expected result for the ring. Returns false, after printing which one differs,
+     * if they do not.
+     */
+    bool
+    checks_agree(xmreg::MicroCore& mcore,
+                 xmreg::PointCache& point_cache,
+                 const ring_fixture& ring,
+                 const vector<crypto::signature>& signatures,
+                 bool expected,
+                 const string& label)
+    {
+        bool consensus = crypto::check_ring_signature(
+                ring.prefix_hash, ring.image,
+                ring.pub_key_ptrs, signatures.data());
+
+        uint64_t micro_core;
+
+        mcore.check_ring_signature(ring.prefix_hash, ring.image,
+                                   ring.pub_keys, signatures, micro_core);
+
+        xmreg::ring_signature_record record {
+                &ring.prefix_hash, &ring.image, ring.pub_keys.data(),
+                signatures.data(), ring.pub_keys.size()};
+
+        bool batch = mcore.check_ring_signatures(&record, 1)[0];
+
+        bool cached = point_cache.check_ring_signature(
+                ring.prefix_hash, ring.image,
+                ring.pub_keys.data(), ring.pub_keys.size(),
+                signatures.data());
+
+        if (consensus != expected
+            || static_cast<bool>(micro_core) != consensus
+            || batch != consensus
+            || cached != consensus)
+        {
+            cerr << fmt::format("Ring size {}, {}: expected {}, crypto: {}, "
+                                "MicroCore: {}, MicroCore batch: {}, "
+                                "PointCache: {}\n",
+                                ring.pub_keys.size(), label, expected,
+                                consensus, micro_core, batch, cached);
+            return false;
+        }
+
+        return true;
+    }
+
+
+    void
+    write_json(ostream& os, const vector<bench_result>& results, double min_time)
+    {
+        fmt::MemoryWriter w;
+
+        w << "{\n  \"min_time\": " << min_time << ",\n  \"benchmarks\": [\n";
+
+        for (size_t i = 0; i < results.size(); ++i)
+        {
+            const bench_result& r = results[i];
+
+            double ns_per_op = r.seconds * 1e9 / r.iterations;
+
+            w.write("    {{\"name\": \"{}\", \"ring_size\": {}, "
+                    "\"iterations\": {}, \"ns_per_op\": {:.1f}, "
+                    "\"ops_per_sec\": {:.1f}}}{}\n",
+                    r.name, r.ring_size, r.iterations, ns_per_op,
+                    1e9 / ns_per_op,
+                    i + 1 < results.size() ? "," : "");
+        }
+
+        w << "  ]\n}\n";
+
+        os << w.str();
+    }
+
+}
+
+
+int main(int ac, const char* av[])
+{
+    po::options_description desc("rings_bench, benchmark ring signature crypto");
+
+    desc.add_options()
+            ("help,h", "produce help message")
+            ("min-time", po::value<double>()->default_value(0.5),
+             "minimum time in seconds of each benchmark")
+            ("max-ring-size", po::value<size_t>()->default_value(64),
+             "largest ring size to benchmark")
+            ("output,o", po::value<string>(),
+             "write json results to this file instead of stdout");
+
+    po::variables_map vm;
+
+    try
+    {
+        po::store(po::parse_command_line(ac, av, desc), vm);
+        po::notify(vm);
+    }
+    catch (const po::error& e)
+    {
+        cerr << e.what() << "\n" << desc << endl;
+        return 1;
+    }
+
+    if (vm.count("help"))
+    {
+        cout << desc << endl;
+        return 0;
+    }
+
+    double min_time      = vm["min-time"].as<double>();
+    size_t max_ring_size = vm["max-ring-size"].as<size_t>();
+
+    vector<size_t> ring_sizes;
+
+    for (size_t ring_size: {1, 2, 3, 4, 5, 8, 16, 32, 64})
+    {
+        if (ring_size <= max_ring_size)
+        {
+            ring_sizes.push_back(ring_size);
+        }
+    }
+
+    vector<bench_result> results;
+
+
+    // key and output derivation
+
+    crypto::public_key pub_key;
+    crypto::secret_key sec_key;
+
+    crypto::generate_keys(pub_key, sec_key);
+
+    crypto::public_key tx_pub_key;
+    crypto::secret_key tx_sec_key;
+
+    crypto::generate_keys(tx_pub_key, tx_sec_key);
+
+    crypto::key_derivation derivation;
+    crypto::generate_key_derivation(tx_pub_key, sec_key, derivation);
+
+    results.push_back(run_bench("generate_key_image", 1, min_time, [&]
+    {
+        crypto::key_image image;
+        crypto::generate_key_image(pub_key, sec_key, image);
+        return static_cast<uint64_t>(image.data[0]);
+    }));
+
+    results.push_back(run_bench("generate_key_derivation", 1, min_time, [&]
+    {
+        crypto::key_derivation d;
+        return static_cast<uint64_t>(
+                crypto::generate_key_derivation(tx_pub_key, sec_key, d));
+    }));
+
+    results.push_back(run_bench("derive_public_key", 1, min_time, [&]
+    {
+        crypto::public_key derived;
+        return static_cast<uint64_t>(
+                crypto::derive_public_key(derivation, 0, pub_key, derived));
+    }));
+
+
+    // ring signatures
+
+    xmreg::MicroCore mcore;
+
+    // number of rings checked in one batch call
+    const uint64_t BATCH_SIZE {16};
+
+    // number of benchmarked checks of valid rings that failed
+    uint64_t failed_checks {0};
+
+    for (size_t ring_size: ring_sizes)
+    {
+        ring_fixture ring {ring_size};
+
+        // all checks timed below must agree, on valid and tampered rings
+        xmreg::PointCache point_cache {1024 * 1024};
+
+        vector<crypto::signature> tampered = ring.signatures;
+        tampered[0].c.data[0] ^= 1;
+
+        if (!checks_agree(mcore, point_cache, ring, ring.signatures, true, "valid")
+            || !checks_agree(mcore, point_cache, ring, ring.signatures, true, "valid, cached")
+            || !checks_agree(mcore, point_cache, ring, tampered, false, "tampered")
+            || !xmreg::PointCache::agrees_with_crypto(ring_size))
+        {
+            cerr << "Ring signature checks disagree for ring size "
+                 << ring_size << endl;
+            return 1;
+        }
+
+        results.push_back(run_bench("generate_ring_signature", ring_size, min_time, [&]
+        {
+            crypto::generate_ring_signature(ring.prefix_hash, ring.image,
+                                            ring.pub_key_ptrs,
+                                            ring.real_sec, ring.real_index,
+                                            ring.signatures.data());
+            return static_cast<uint64_t>(ring.signatures[0].c.data[0]);
+        }));
+
+        results.push_back(run_bench("check_ring_signature", ring_size, min_time, [&]
+        {
+            bool valid = crypto::check_ring_signature(ring.prefix_hash, ring.image,
+                                                      ring.pub_key_ptrs,
+                                                      ring.signatures.data());
+            failed_checks += !valid;
+            return static_cast<uint64_t>(valid);
+        }));
+
+        results.push_back(run_bench("MicroCore::check_ring_signature", ring_size, min_time, [&]
+        {
+            uint64_t result;
+            mcore.check_ring_signature(ring.prefix_hash, ring.image,
+                                       ring.pub_keys, ring.signatures,
+                                       result);
+            failed_checks += !result;
+            return result;
+        }));
+
+        // the same ring many times, as in a batch of small rings
+        vector<xmreg::ring_signature_record> records(
+                BATCH_SIZE, xmreg::ring_signature_record {
+                        &ring.prefix_hash, &ring.image, ring.pub_keys.data(),
+                        ring.signatures.data(), ring.pub_keys.size()});
+
+        results.push_back(run_bench("MicroCore::check_ring_signatures", ring_size, min_time, [&]
+        {
+            boost::dynamic_bitset<> valid = mcore.check_ring_signatures(records);
+            failed_checks += valid.size() - valid.count();
+            return static_cast<uint64_t>(valid.count());
+        }, BATCH_SIZE));
+
+        // all ring members are in the cache after the checks above
+        results.push_back(run_bench("PointCache::check_ring_signature", ring_size, min_time, [&]
+        {
+            bool valid = point_cache.check_ring_signature(ring.prefix_hash, ring.image,
+                                                          ring.pub_keys.data(),
+                                                          ring.pub_keys.size(),
+                                                          ring.signatures.data());
+            failed_checks += !valid;
+            return static_cast<uint64_t>(valid);
+        }));
+    }
+
+    if (failed_checks > 0)
+    {
+        cerr << failed_checks << " benchmarked checks of valid rings failed" << endl;
+        return 1;
+    }
+
+
+    if (vm.count("output"))
+    {
+        ofstream out {vm["output"].as<string>()};
+
+        if (!out)
+        {
+            cerr << "Cant open " << vm["output"].as<string>() << endl;
+            return 1;
+        }
+
+        write_json(out, results, min_time);
+    }
+    else
+    {
+        write_json(cout, results, min_time);
+    }
+
+    return 0;
+}
@@ -1,9 +1,23 @@
 #include "src/MicroCore.h"
 #include "src/CmdLineOptions.h"
 #include "src/tools.h"
+#include "src/RingVerifier.h"
+#include "src/OutputKeyResolver.h"
+#include "src/RingServer.h"
+#include "src/BatchVerifier.h"
+#include "src/RangeScanner.h"
+#include "src/RingDump.h"
+#include "src/StageStats.h"
+#include "src/MetricsExporter.h"
+#include "src/ParallelOutputScanner.h"
+#include "src/TransferCsvWriter.h"
+#include "src/MultiAccountScanner.h"
 
 #include "ext/format.h"
 
+#include <chrono>
+#include <fstream>
+
 using namespace std;
 using namespace fmt;
 
@@ -13,10 +27,211 @@ using xmreg::print_sig;
 
 using boost::filesystem::path;
 
+using std::chrono::steady_clock;
+using std::chrono::duration_cast;
+using std::chrono::microseconds;
+
 namespace epee {
     unsigned int g_test_dbg_lock_sleep = 0;
 }
 
+/**
+ * Open the blockchain no_of_runs times in each of the
+ * startup modes and print average time of MicroCore::init
+ */
+void
+bench_startup(const string& blockchain_path, size_t no_of_runs)
+{
+    struct startup_mode
+    {
+        const char* name;
+        bool read_only;
+        bool with_core;
+    };
+
+    const vector<startup_mode> modes {
+            {"full core", false, true},
+            {"fast startup", false, false},
+            {"read only", true, false}};
+
+    print("\nStartup benchmark, {} runs per mode\n", no_of_runs);
+
+    for (const startup_mode& mode: modes)
+    {
+        uint64_t total_us {0};
+
+        for (size_t i = 0; i < no_of_runs; ++i)
+        {
+            auto start = steady_clock::now();
+
+            {
+                xmreg::MicroCore mcore;
+
+                if (!mcore.init(blockchain_path, mode.read_only, mode.with_core))
+                {
+                    cerr << "Error accessing blockchain in mode: "
+                         << mode.name << endl;
+                    return;
+                }
+            }
+
+            total_us += duration_cast<microseconds>(
+                    steady_clock::now() - start).count();
+        }
+
+        print(" - {:<14}: {:.3f} ms\n", mode.name,
+              total_us / 1000.0 / no_of_runs);
+    }
+}
+
+
+/**
+ * Print rings of a dump written with --binary-out,
+ * without opening the blockchain
+ */
+bool
+print_ring_dump(const string& dump_path)
+{
+    xmreg::RingDumpReader dump;
+
+    if (!dump.open(dump_path))
+    {
+        return false;
+    }
+
+    uint64_t no_of_invalid {0};
+
+    for (uint64_t ring_i = 0; ring_i < dump.no_of_rings(); ++ring_i)
+    {
+        bool valid = dump.is_valid(ring_i);
+
+        no_of_invalid += !valid;
+
+        print("Tx {}, input no {}: key image {}, ring size {}, valid: {}\n",
+              dump.tx_hash(ring_i), dump.input_index(ring_i),
+              dump.get_key_image(ring_i), dump.ring_size(ring_i), valid);
+
+        const crypto::public_key* members = dump.members(ring_i);
+        const crypto::signature* signatures = dump.signatures(ring_i);
+
+        for (uint64_t i = 0; i < dump.ring_size(ring_i); ++i)
+        {
+            print("  - mix out pubkey: {}\n", members[i]);
+            print("    - sig: {}\n", signatures[i]);
+        }
+    }
+
+    print("\nRings: {}, signatures: {}, invalid: {}\n",
+          dump.no_of_rings(), dump.no_of_members(), no_of_invalid);
+
+    return true;
+}
+
+
+/**
+ * Last block to scan: --end-height, if given, limited to the
+ * top block as the scanners do, so that the printed range is
+ * the one that is scanned.
+ *
+ * Returns false if the range from start_height is empty.
+ */
+bool
+get_end_height(xmreg::MicroCore& mcore,
+               uint64_t start_height,
+               const boost::optional<size_t>& end_height_opt,
+               uint64_t& end_height)
+{
+    uint64_t blockchain_height = mcore.get_db().height();
+
+    if (blockchain_height == 0 || start_height >= blockchain_height)
+    {
+        cerr << "Start height " << start_height
+             << " is above blockchain height "
+             << blockchain_height << endl;
+        return false;
+    }
+
+    end_height = end_height_opt
+                 ? std::min<uint64_t>(*end_height_opt, blockchain_height - 1)
+                 : blockchain_height - 1;
+
+    if (end_height < start_height)
+    {
+        cerr << "End height " << end_height
+             << " is below start height " << start_height << endl;
+        return false;
+    }
+
+    return true;
+}
+
+
+/**
+ * Print hit/miss counters of MicroCore's caches
+ */
+void
+print_cache_stats(const xmreg::MicroCore& mcore)
+{
+    const xmreg::MicroCore::tx_cache_t& tx_cache = mcore.get_tx_cache();
+
+    print("Tx cache: {} txs, hits: {}, misses: {}, hit rate: {:.1f}%\n",
+          tx_cache.size(), tx_cache.hits(), tx_cache.misses(),
+          tx_cache.hit_rate() * 100.0);
+
+    const xmreg::MicroCore::block_cache_t& block_cache = mcore.get_block_cache();
+
+    print("Block cache: {} blocks, {:.1f} MB, hits: {}, misses: {}, hit rate: {:.1f}%\n",
+          block_cache.size(), block_cache.cost() / (1024.0 * 1024.0),
+          block_cache.hits(), block_cache.misses(),
+          block_cache.hit_rate() * 100.0);
+}
+
+
+void
+print_point_cache_stats(const xmreg::RingVerifier& verifier)
+{
+    const xmreg::PointCache::cache_t& point_cache = verifier.get_point_cache();
+
+    print("Point cache: {} keys, {:.1f} MB, hits: {}, misses: {}, hit rate: {:.1f}%\n",
+          point_cache.size(), point_cache.cost() / (1024.0 * 1024.0),
+          point_cache.hits(), point_cache.misses(),
+          point_cache.hit_rate() * 100.0);
+}
+
+
+/**
+ * Prints and/or writes stage stats
+ * when it goes out of scope
+ */
+struct stats_report
+{
+    bool print_summary;
+    string json_path;
+
+    ~stats_report()
+    {
+        if (print_summary)
+        {
+            cout << "\nStage stats:\n";
+            xmreg::StageStats::print_summary(cout);
+        }
+
+        if (!json_path.empty())
+        {
+            ofstream json_file {json_path};
+
+            if (!json_file)
+            {
+                cerr << "Cant open " << json_path << endl;
+                return;
+            }
+
+            xmreg::StageStats::write_json(json_file);
+        }
+    }
+};
+
+
 struct for_signatures
 {
     crypto::hash tx_hash ;
@@ -50,6 +265,51 @@ int main(int ac, const char* av[]) {
     auto viewkey_opt = opts.get_option<string>("viewkey");
     auto address_opt = opts.get_option<string>("address");
     auto bc_path_opt = opts.get_option<string>("bc-path");
+    auto read_only_opt = opts.get_option<bool>("read-only");
+    auto fast_startup_opt = opts.get_option<bool>("fast-startup");
+    auto startup_bench_opt = opts.get_option<size_t>("startup-bench");
+    auto threads_opt = opts.get_option<size_t>("threads");
+    auto tx_cache_size_opt = opts.get_option<size_t>("tx-cache-size");
+    auto block_cache_mb_opt = opts.get_option<size_t>("block-cache-mb");
+    auto point_cache_mb_opt = opts.get_option<size_t>("point-cache-mb");
+    auto output_index_opt = opts.get_option<bool>("output-index");
+    auto output_index_path_opt = opts.get_option<string>("output-index-path");
+    auto server_opt = opts.get_option<bool>("server");
+    auto socket_opt = opts.get_option<string>("socket");
+    auto tx_file_opt = opts.get_option<string>("tx-file");
+    auto queue_size_opt = opts.get_option<size_t>("queue-size");
+    auto start_height_opt = opts.get_option<size_t>("start-height");
+    auto end_height_opt = opts.get_option<size_t>("end-height");
+    auto scan_outputs_opt = opts.get_option<bool>("scan-outputs");
+    auto accounts_file_opt = opts.get_option<string>("accounts-file");
+    auto csv_out_opt = opts.get_option<string>("csv-out");
+    auto binary_out_opt = opts.get_option<string>("binary-out");
+    auto binary_in_opt = opts.get_option<string>("binary-in");
+    auto verify_opt = opts.get_option<bool>("verify");
+    auto stats_opt = opts.get_option<bool>("stats");
+    auto stats_json_opt = opts.get_option<string>("stats-json");
+    auto metrics_port_opt = opts.get_option<size_t>("metrics-port");
+    auto metrics_file_opt = opts.get_option<string>("metrics-file");
+    auto metrics_interval_opt = opts.get_option<size_t>("metrics-interval");
+
+
+    // stage timings are printed when main returns
+    xmreg::StageStats::set_enabled(*stats_opt || stats_json_opt
+                                   || *metrics_port_opt > 0 || metrics_file_opt);
+
+    stats_report report {*stats_opt, stats_json_opt ? *stats_json_opt : ""};
+
+    if (*metrics_port_opt > 65535)
+    {
+        cerr << "Invalid metrics port: " << *metrics_port_opt << endl;
+        return 1;
+    }
+
+
+    if (binary_in_opt)
+    {
+        return print_ring_dump(*binary_in_opt) ? 0 : 1;
+    }
 
 
     // get the program command line options, or
@@ -72,10 +332,14 @@ int main(int ac, const char* av[]) {
     cryptonote::account_public_address address;
 
 
-    string viewkey_str {"fed77158ec692fe9eb951f6aeb22c3bda16fe8926c1aac13a5651a9c27f34309"};
+    string viewkey_str = viewkey_opt
+                         ? *viewkey_opt
+                         : "fed77158ec692fe9eb951f6aeb22c3bda16fe8926c1aac13a5651a9c27f34309";
     string spendkey_str {"1eaa41781d5f880dc69c9379e281225c781a6db8dc544a26008e7a07890afa03"};
 
-    string address_str {"41vEA7Ye8Bpeda6g59v5t46koWrVn2PNgEKgzquJjmiKCFTsh9gajr8J3pad49rqu581TAtFGCH9CYTCkYrCpuWUG9GkgeB"};
+    string address_str = address_opt
+                         ? *address_opt
+                         : "41vEA7Ye8Bpeda6g59v5t46koWrVn2PNgEKgzquJjmiKCFTsh9gajr8J3pad49rqu581TAtFGCH9CYTCkYrCpuWUG9GkgeB";
 
 
     // parse string representing given private viewkey
@@ -117,16 +381,359 @@ int main(int ac, const char* av[]) {
     // enable basic monero log output
     xmreg::enable_monero_log();
 
+    if (*startup_bench_opt > 0)
+    {
+        bench_startup(blockchain_path.string(), *startup_bench_opt);
+        return 0;
+    }
+
     // create instance of our MicroCore
     xmreg::MicroCore mcore;
 
-    // initialize the core using the blockchain path
-    if (!mcore.init(blockchain_path.string()))
+    auto init_start = steady_clock::now();
+
+    // initialize the core using the blockchain path.
+    // we only read from the database, so the Blockchain
+    // object is not needed in fast startup mode.
+    if (!mcore.init(blockchain_path.string(),
+                    *read_only_opt,
+                    !*fast_startup_opt))
     {
         cerr << "Error accessing blockchain." << endl;
         return 1;
     }
 
+    mcore.set_tx_cache_size(*tx_cache_size_opt);
+    mcore.set_block_cache_size(*block_cache_mb_opt * 1024 * 1024);
+
+    size_t point_cache_size = *point_cache_mb_opt * 1024 * 1024;
+
+    print("Startup time         : {:.3f} ms\n",
+          duration_cast<microseconds>(
+                  steady_clock::now() - init_start).count() / 1000.0);
+
+
+    // output public key index, used to find txs of
+    // mixins without scanning their blocks
+    xmreg::OutputIndex output_index;
+
+    if (*output_index_opt)
+    {
+        string output_index_path = output_index_path_opt
+                                   ? *output_index_path_opt
+                                   : xmreg::OutputIndex::get_default_path(
+                                           blockchain_path.string());
+
+        print("Output index path    : {}\n", output_index_path);
+
+        if (*read_only_opt)
+        {
+            // nothing is written in read only mode, so the index
+            // is used as it is, but only if the blockchain still
+            // has its top block. outputs of blocks added since
+            // it was built are found by searching their blocks.
+            if (output_index.open(output_index_path, true)
+                && output_index.matches(mcore))
+            {
+                mcore.set_output_index(&output_index);
+            }
+            else
+            {
+                cerr << "Output index is missing or does not match "
+                     << "the blockchain, not using it." << endl;
+            }
+        }
+        else
+        {
+            if (!output_index.open(output_index_path)
+                || !output_index.update(mcore))
+            {
+                cerr << "Error building output index." << endl;
+                return 1;
+            }
+
+            mcore.set_output_index(&output_index);
+        }
+    }
+
+
+    // export metrics while any of the modes below works.
+    // declared after mcore, so that its cache gauges
+    // outlive the exporter.
+    xmreg::MetricsExporter metrics_exporter;
+
+    if (*metrics_port_opt > 0
+        && !metrics_exporter.serve(static_cast<uint16_t>(*metrics_port_opt)))
+    {
+        return 1;
+    }
+
+    if (metrics_file_opt
+        && !metrics_exporter.write_to_file(*metrics_file_opt,
+                                           *metrics_interval_opt))
+    {
+        return 1;
+    }
+
+
+    if (*server_opt)
+    {
+        // serve requests until killed
+        string socket_path = socket_opt
+                             ? *socket_opt
+                             : xmreg::RingServer::get_default_socket_path(
+                                     blockchain_path.string());
+
+        xmreg::RingServer server {mcore, socket_path, *threads_opt,
+                                   point_cache_size};
+
+        return server.run() ? 0 : 1;
+    }
+
+
+    if (accounts_file_opt)
+    {
+        // find outputs of all the accounts in one pass over the blocks
+        xmreg::MultiAccountScanner scanner {mcore};
+
+        if (!scanner.load_accounts(*accounts_file_opt))
+        {
+            return 1;
+        }
+
+        uint64_t start_height = start_height_opt ? *start_height_opt : 0;
+
+        uint64_t end_height;
+
+        if (!get_end_height(mcore, start_height, end_height_opt, end_height))
+        {
+            return 1;
+        }
+
+        const vector<xmreg::watched_account>& accounts = scanner.get_accounts();
+
+        print("Scanning outputs of {} accounts ({} view keys) in blocks {} - {}\n",
+              accounts.size(), scanner.no_of_view_keys(),
+              start_height, end_height);
+
+        xmreg::output_scan_summary summary;
+
+        bool scan_ok = scanner.scan(start_height, end_height,
+                                    [&](const xmreg::account_output& out)
+        {
+            cout << accounts[out.account_index].label << ": "
+                 << out.output << endl;
+        }, summary);
+
+        print("\nBlocks: {}, txs: {}, outputs checked: {}, time: {:.3f} s\n",
+              summary.no_of_blocks, summary.no_of_txs,
+              summary.no_of_outputs, summary.seconds);
+
+        return scan_ok ? 0 : 1;
+    }
+
+
+    if (*scan_outputs_opt)
+    {
+        // find outputs of the given address in a range of blocks
+        uint64_t start_height = start_height_opt ? *start_height_opt : 0;
+
+        uint64_t end_height;
+
+        if (!get_end_height(mcore, start_height, end_height_opt, end_height))
+        {
+            return 1;
+        }
+
+        // blocks are scanned in chunks on all --threads, and
+        // outputs found are reported in height order
+        xmreg::ParallelOutputScanner scanner {mcore,
+                                              private_view_key,
+                                              address.m_spend_public_key,
+                                              *threads_opt};
+
+        xmreg::output_scan_summary summary;
+
+        print("Scanning outputs of {} in blocks {} - {}\n",
+              address_str, start_height, end_height);
+
+        uint64_t total_amount {0};
+
+        unique_ptr<xmreg::TransferCsvWriter> csv_writer;
+
+        if (csv_out_opt)
+        {
+            csv_writer.reset(new xmreg::TransferCsvWriter(*csv_out_opt));
+
+            if (!csv_writer->is_open())
+            {
+                return 1;
+            }
+
+            csv_writer->write_header();
+        }
+
+        bool scan_ok = scanner.scan(start_height, end_height,
+                                    [&](const xmreg::transfer_details& td)
+        {
+            total_amount += td.amount();
+
+            if (csv_writer)
+            {
+                csv_writer->write(td);
+            }
+            else
+            {
+                cout << td << endl;
+            }
+        }, summary);
+
+        if (csv_writer && !csv_writer->close())
+        {
+            return 1;
+        }
+
+        print("\nBlocks: {}, txs: {}, outputs checked: {}, time: {:.3f} s\n",
+              summary.no_of_blocks, summary.no_of_txs,
+              summary.no_of_outputs, summary.seconds);
+
+        print("Total received: {}\n", cryptonote::print_money(total_amount));
+
+        return scan_ok ? 0 : 1;
+    }
+
+
+    if (start_height_opt)
+    {
+        // verify all rings in the given range of blocks
+        uint64_t end_height;
+
+        if (!get_end_height(mcore, *start_height_opt, end_height_opt, end_height))
+        {
+            return 1;
+        }
+
+        xmreg::RingVerifier verifier {mcore, *threads_opt, point_cache_size};
+        xmreg::RangeScanner scanner {mcore, verifier};
+
+        xmreg::range_scan_summary summary;
+
+        print("Scanning blocks {} - {}\n", *start_height_opt, end_height);
+
+        auto print_invalid = [](uint64_t height,
+                                const crypto::hash& tx_hash,
+                                size_t input_index)
+        {
+            print("Invalid ring: blk {}, tx {}, input no {}\n",
+                  height, tx_hash, input_index);
+        };
+
+        unique_ptr<xmreg::RingDumpWriter> ring_dump;
+
+        if (binary_out_opt)
+        {
+            ring_dump.reset(new xmreg::RingDumpWriter(*binary_out_opt));
+
+            if (!ring_dump->is_open())
+            {
+                return 1;
+            }
+
+            scanner.set_ring_callback([&](uint64_t height,
+                                          const crypto::hash& tx_hash,
+                                          const xmreg::ring_data& ring,
+                                          bool valid)
+            {
+                ring_dump->add_ring(tx_hash, ring.input_index, ring.k_image,
+                                    ring.pub_keys, ring.signatures, valid);
+            });
+        }
+
+        bool scan_ok = scanner.scan(*start_height_opt, end_height,
+                                    summary, print_invalid);
+
+        if (ring_dump)
+        {
+            uint64_t no_of_dumped = ring_dump->no_of_rings();
+
+            if (!ring_dump->close())
+            {
+                return 1;
+            }
+
+            print("Dumped {} rings to {}\n", no_of_dumped, *binary_out_opt);
+        }
+
+        double secs = summary.seconds > 0 ? summary.seconds : 1e-9;
+
+        print("\nBlocks: {}, txs: {}, rings: {}, signatures: {}, invalid: {}\n",
+              summary.no_of_blocks, summary.no_of_txs, summary.no_of_rings,
+              summary.no_of_signatures, summary.no_of_invalid);
+
+        print("Time: {:.3f} s, {:.1f} blocks/s, {:.1f} rings/s, {:.1f} signatures/s\n",
+              summary.seconds,
+              summary.no_of_blocks / secs,
+              summary.no_of_rings / secs,
+              summary.no_of_signatures / secs);
+
+        print_cache_stats(mcore);
+        print_point_cache_stats(verifier);
+
+        return scan_ok && summary.no_of_invalid == 0 ? 0 : 1;
+    }
+
+
+    if (tx_file_opt)
+    {
+        // verify many txs using the one opened blockchain
+        ifstream tx_file;
+
+        if (*tx_file_opt != "-")
+        {
+            tx_file.open(*tx_file_opt);
+
+            if (!tx_file)
+            {
+                cerr << "Cant open tx file: " << *tx_file_opt << endl;
+                return 1;
+            }
+        }
+
+        istream& hashes_stream = *tx_file_opt == "-"
+                                 ? static_cast<istream&>(cin)
+                                 : tx_file;
+
+        xmreg::RingVerifier verifier {mcore, *threads_opt, point_cache_size};
+        xmreg::BatchVerifier batch_verifier {mcore, verifier, *queue_size_opt};
+
+        xmreg::batch_summary summary;
+
+        bool run_ok = batch_verifier.run(hashes_stream,
+                                         [](const xmreg::tx_verify_result& result)
+        {
+            print("{}: {}, rings: {}\n", result.tx_hash,
+                  !result.found ? "not found"
+                                : result.is_valid() ? "valid" : "invalid",
+                  result.no_of_rings);
+        }, summary);
+
+        print("\nTxs: {}, not found: {}, invalid: {}, rings: {}, unparsed lines: {}\n",
+              summary.no_of_txs, summary.no_of_not_found,
+              summary.no_of_invalid, summary.no_of_rings,
+              summary.no_of_unparsed);
+
+        print("Time: {:.3f} s, {:.1f} txs/s, {:.1f} rings/s\n",
+              summary.seconds,
+              summary.seconds > 0 ? summary.no_of_txs / summary.seconds : 0.0,
+              summary.seconds > 0 ? summary.no_of_rings / summary.seconds : 0.0);
+
+        print_cache_stats(mcore);
+        print_point_cache_stats(verifier);
+
+        return run_ok && summary.no_of_not_found + summary.no_of_invalid == 0
+               ? 0 : 1;
+    }
+
 
     print("\n\ntx hash          : {}\n\n", tx_hash);
 
@@ -138,16 +745,16 @@ int main(int ac, const char* av[]) {
 
 
 
-    // get the high level cryptonote::Blockchain object to interact
-    // with the blockchain lmdb database
-    cryptonote::Blockchain& core_storage = mcore.get_core();
+    // get the blockchain lmdb database. it is
+    // available also in the read only mode
+    cryptonote::BlockchainDB& blockchain_db = mcore.get_db();
 
     cryptonote::transaction tx;
 
     try
     {
         // get transaction with given hash
-        tx = core_storage.get_db().get_tx(tx_hash);
+        tx = blockchain_db.get_tx(tx_hash);
     }
     catch (const std::exception& e)
     {
@@ -166,17 +773,87 @@ int main(int ac, const char* av[]) {
     vector<uint64_t> results;
     results.resize(tx.vin.size(), 0);
 
+    xmreg::RingVerifier verifier {mcore, *threads_opt, point_cache_size};
+
+    if (*verify_opt)
+    {
+        // check full ring of each input exactly once, one after
+        // another in this thread, so that each check can be timed
+        vector<xmreg::ring_data> rings;
+
+        if (!verifier.get_rings(tx, rings))
+        {
+            cerr << "Cant get rings of tx: " << tx_hash << endl;
+            return 1;
+        }
+
+        bool all_valid = !rings.empty();
+
+        microseconds total_time {0};
+
+        for (const xmreg::ring_data& ring: rings)
+        {
+            auto start = steady_clock::now();
+
+            bool valid = verifier.check_ring(tx_prefix_hash, ring);
+
+            microseconds check_time = duration_cast<microseconds>(
+                    steady_clock::now() - start);
+
+            total_time += check_time;
+
+            all_valid = all_valid && valid;
+
+            print("Input {:>3}: key image {}, ring size {:>3}, valid: {}, time: {} us\n",
+                  ring.input_index, ring.k_image, ring.pub_keys.size(),
+                  valid, check_time.count());
+        }
+
+        print("Tx {}: {} rings, all valid: {}, total time: {} us\n",
+              tx_hash, rings.size(), all_valid, total_time.count());
+
+        return all_valid ? 0 : 1;
+    }
+
+    // verify rings of all inputs in parallel, one input per worker task.
+    // results are stored in input order.
+
+    if (!verifier.verify_tx(tx, results))
+    {
+        cerr << "Cant verify ring signatures of tx: " << tx_hash << endl;
+        return 1;
+    }
+
 
     cryptonote::account_keys sender_account_keys {address,
                                                   private_spend_key,
                                                   private_view_key};
 
+    xmreg::StageTimer& key_image_timer
+            = xmreg::StageStats::timer("generate_key_image");
+
+
+    // read ring members of all inputs at once,
+    // rather than input by input below
+    xmreg::OutputKeyResolver output_resolver {blockchain_db};
+
+    output_resolver.add_tx(tx);
+
+    if (!output_resolver.resolve())
+    {
+        cerr << "Cant get ring members of tx: " << tx_hash << endl;
+        return 1;
+    }
+
 
 
 
     for (size_t i = 0; i < tx.vin.size(); ++i)
     {
-        vector<for_signatures> for_sig_v;
+        // ring member that belongs to the sender, if any,
+        // to sign the ring again with its key
+        for_signatures real_input;
+        bool has_real_input {false};
 
         const cryptonote::txin_v &tx_in = tx.vin[i];
 
@@ -185,7 +862,8 @@ int main(int ac, const char* av[]) {
                 = boost::get<cryptonote::txin_to_key>(tx_in);
 
 
-        cout << "Key image: " << tx_in_to_key.k_image << endl;
+        print("Key image: {}\n", tx_in_to_key.k_image);
+        cout << "Ring signature valid: " << results[i] << endl;
 
 
         uint64_t pmax_used_block_height{0};
@@ -200,9 +878,14 @@ int main(int ac, const char* av[]) {
 
         // get public keys used in a given mixin
         std::vector<cryptonote::output_data_t> outputs;
-        core_storage.get_db().get_output_key(tx_in_to_key.amount,
-                                             absolute_offsets,
-                                             outputs);
+
+        if (!output_resolver.get(tx_in_to_key.amount,
+                                 absolute_offsets,
+                                 outputs))
+        {
+            cerr << "Cant get ring members of input no: " << i << endl;
+            return 1;
+        }
 
 
         vector<crypto::public_key> outs_pub_keys;
@@ -224,53 +907,11 @@ int main(int ac, const char* av[]) {
             cryptonote::output_data_t output_data = outputs.at(outi);
 
 
-            cout << "  - mix out pubkey: " << output_data.pubkey << endl;
-            //cout << "  - sig: " << tx.signatures[i][outi] << endl;
+            print("  - mix out pubkey: {}\n", output_data.pubkey);
 
-            vector<const crypto::public_key*> out_pub_key_array;
-
-            out_pub_key_array.push_back(&output_data.pubkey);
-            vector<crypto::signature> sig_array;
-            sig_array.push_back(tx.signatures[i][outi]);
-//
-//            crypto::check_ring_signature(tx_prefix_hash,
-//                                         tx_in_to_key.k_image,
-//                                         out_pub_key_array,
-//                                         tx.signatures[i].data());
-
-//            crypto::crypto_ops::check_ring_signature(tx_prefix_hash,
-//                                                     tx_in_to_key.k_image,
-//                                                     out_pub_key_array.data(),
-//                                                     out_pub_key_array.size(),
-//                                                     sig_array.data());
-
-
-//            bool result = crypto::check_ring_signature(tx_prefix_hash,
-//                                         tx_in_to_key.k_image,
-//                                         out_pub_key_array.data(),
-//                                         out_pub_key_array.size(),
-//                                         sig_array.data());
-
-
-            for (const crypto::signature &sig: tx.signatures[i])
-            {
-                cout << "    - sig: " << print_sig(sig) << endl;
-//                bool result = crypto::check_signature(tx_prefix_hash,
-//                                                      output_data.pubkey,
-//                                                      sig);
-
-                vector<crypto::signature> sig_array;
-                sig_array.push_back(sig);
-
-                bool result = crypto::check_ring_signature(tx_prefix_hash,
-                                                           tx_in_to_key.k_image,
-                                                           out_pub_key_array.data(),
-                                                           out_pub_key_array.size(),
-                                                           sig_array.data());
-
-                cout << "    - result: " << result << endl;
-
-            }
+            // signature of this ring member. the ring as a whole
+            // was already checked once, above.
+            print("    - sig: {}\n", tx.signatures[i][outi]);
 
 
             // find tx_hash with given output
@@ -315,11 +956,19 @@ int main(int ac, const char* av[]) {
             cryptonote::keypair in_ephemeral;
             crypto::key_image ki;
 
-            if (!generate_key_image_helper(sender_account_keys,
-                                           pub_tx_key,
-                                           output_index,
-                                           in_ephemeral,
-                                           ki))
+            bool key_image_ok;
+
+            {
+                xmreg::ScopedTimer timer {key_image_timer};
+
+                key_image_ok = generate_key_image_helper(sender_account_keys,
+                                                         pub_tx_key,
+                                                         output_index,
+                                                         in_ephemeral,
+                                                         ki);
+            }
+
+            if (!key_image_ok)
             {
                    return false;
             }
@@ -336,46 +985,26 @@ int main(int ac, const char* av[]) {
 
             cout << "ki: " << ki << endl;
 
-            for_signatures fs;
-
-            //fs.tx_hash = cryptonote::get_transaction_hash(tx);
-            fs.tx_hash = cryptonote::get_transaction_prefix_hash(tx);
-            //fs.tx_hash = tx_hash_found;
-            fs.kimg = ki;
-            fs.outs_pub_keys = outs_pub_keys;
-            fs.in_ephemeral = in_ephemeral;
-            fs.real_output = absolute_offsets.size();
-
-            for_sig_v.push_back(fs);
-
+            if (!has_real_input && output_data.pubkey == in_ephemeral.pub)
+            {
+                real_input.tx_hash = cryptonote::get_transaction_prefix_hash(tx);
+                real_input.kimg = ki;
+                real_input.outs_pub_keys = outs_pub_keys;
+                real_input.in_ephemeral = in_ephemeral;
+                real_input.real_output = outi;
 
-            //outs_pub_keys.push_back(output_data.pubkey);
+                has_real_input = true;
+            }
 
         } //  for (size_t outi = 0; outi < absolute_offsets.size(); ++outi)
 
 
 
-
-        cout << "\n\n\nfor_sig_v.size(): " << for_sig_v.size() << endl;
-
-
-        std::vector<std::vector<crypto::signature> > signatures;
-
-
-
-        for (const for_signatures& fs: for_sig_v)
+        // sign the whole ring once, with the real member's key,
+        // and check the new signature
+        if (has_real_input)
         {
-
-           // std::vector<crypto::signature> new_sigs(absolute_offsets.size());
-
-
-//            signatures.push_back(std::vector<crypto::signature>());
-//            std::vector<crypto::signature>& sigs = signatures.back();
-//            sigs.resize(absolute_offsets.size());
-
-
-
-            crypto::signature* sigs = new crypto::signature[4];
+            const for_signatures& fs = real_input;
 
             cout <<"\n"
                  << "tx_hash_prefix: " << fs.tx_hash << "\n"
@@ -390,38 +1019,32 @@ int main(int ac, const char* av[]) {
             {
                 keys_ptrs.push_back(&pk);
                 cout << " - " << pk << endl;
-
             }
 
+            // one signature per ring member
+            std::vector<crypto::signature> sigs(keys_ptrs.size());
 
             crypto::generate_ring_signature(fs.tx_hash,
                                             fs.kimg,
                                             keys_ptrs,
                                             fs.in_ephemeral.sec,
-                                            fs.real_output - 1,
-                                            sigs);
+                                            fs.real_output,
+                                            sigs.data());
 
             cout << "\n - generate_ring_signature: " << endl;
-            for (size_t i = 0; i < 4; ++i)
+
+            for (const crypto::signature& sig: sigs)
             {
-                cout << "    - sig: " << print_sig(sigs[i]) << endl;
+                print("    - sig: {}\n", sig);
             }
 
-
-
-
-
-            bool result;
-
-            result = crypto::check_ring_signature(
+            bool result = crypto::check_ring_signature(
                     fs.tx_hash,
                     fs.kimg,
                     keys_ptrs,
-                    sigs);
+                    sigs.data());
 
             cout <<  "\n - result: " << result << "\n\n" << endl ;
-
-            delete[] sigs;
         }
 
 
@@ -510,6 +1133,10 @@ int main(int ac, const char* av[]) {
 
 
 
+    cout << endl;
+    print_cache_stats(mcore);
+    print_point_cache_stats(verifier);
+
     cout << "\nEnd of program." << endl;
 
     return 0;
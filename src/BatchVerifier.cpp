@@ -0,0 +1,255 @@
+#include "BatchVerifier.h"
+#include "tools.h"
+#include "StageStats.h"
+
+#include <chrono>
+#include <thread>
+
+
+namespace xmreg
+{
+
+    namespace
+    {
+        /**
+         * Transaction moving through the pipeline
+         */
+        struct pending_tx
+        {
+            crypto::hash tx_hash;
+            bool found {false};
+            crypto::hash tx_prefix_hash;
+            size_t no_of_inputs {0};
+            vector<ring_data> rings;
+            vector<future<bool>> checks;
+        };
+    }
+
+
+    bool
+    tx_verify_result::is_valid() const
+    {
+        if (!found || no_of_rings == 0)
+        {
+            return false;
+        }
+
+        for (uint64_t result: results)
+        {
+            if (result != 1)
+            {
+                return false;
+            }
+        }
+
+        return true;
+    }
+
+
+    BatchVerifier::BatchVerifier(MicroCore& mcore,
+                                 RingVerifier& verifier,
+                                 size_t queue_size):
+            m_mcore(mcore), m_verifier(verifier),
+            m_queue_size(queue_size > 0 ? queue_size : 1)
+    {}
+
+
+    /**
+     * Verify all txs whose hashes are read from hashes_stream.
+     *
+     * Empty lines and lines starting with # are skipped.
+     * on_result is called for each tx, in the order of the
+     * hashes in the stream.
+     *
+     * Returns false if any other line is not a tx hash. If
+     * on_result throws, the pipeline is stopped and the
+     * exception is rethrown.
+     */
+    bool
+    BatchVerifier::run(istream& hashes_stream,
+                       const result_callback& on_result,
+                       batch_summary& summary)
+    {
+        summary = batch_summary {};
+
+        auto start = chrono::steady_clock::now();
+
+        BoundedQueue<crypto::hash> hash_queue {m_queue_size};
+        BoundedQueue<shared_ptr<pending_tx>> tx_queue {m_queue_size};
+
+        // written only by the reader thread, until it is joined
+        size_t no_of_unparsed {0};
+
+        // stage 1: parse hashes
+        thread reader([&]
+        {
+            string line;
+
+            while (getline(hashes_stream, line))
+            {
+                size_t first = line.find_first_not_of(" \t\r");
+
+                if (first == string::npos || line[first] == '#')
+                {
+                    continue;
+                }
+
+                size_t last = line.find_last_not_of(" \t\r");
+
+                string hash_str = line.substr(first, last - first + 1);
+
+                crypto::hash tx_hash;
+
+                if (!parse_hash256(hash_str, tx_hash))
+                {
+                    cerr << "Cant parse tx hash: " << hash_str << endl;
+                    ++no_of_unparsed;
+                    continue;
+                }
+
+                if (!hash_queue.push(tx_hash))
+                {
+                    break;
+                }
+            }
+
+            hash_queue.close();
+        });
+
+        // stage 2: read txs and public keys of their rings.
+        // all database access is done in this one thread.
+        thread fetcher([&]
+        {
+            crypto::hash tx_hash;
+
+            while (hash_queue.pop(tx_hash))
+            {
+                auto ptx = make_shared<pending_tx>();
+
+                ptx->tx_hash = tx_hash;
+
+                shared_ptr<const transaction> tx;
+
+                if (m_mcore.get_tx(tx_hash, tx)
+                    && m_verifier.get_rings(*tx, ptx->rings))
+                {
+                    ptx->found = true;
+                    ptx->tx_prefix_hash = get_transaction_prefix_hash(*tx);
+                    ptx->no_of_inputs = tx->vin.size();
+                }
+
+                if (!tx_queue.push(ptx))
+                {
+                    break;
+                }
+            }
+
+            tx_queue.close();
+        });
+
+        // stage 3: check signatures in the pool, while keeping
+        // at most m_queue_size txs in flight, and report results
+        // in order.
+        deque<shared_ptr<pending_tx>> in_flight;
+
+        auto report_oldest = [&]
+        {
+            shared_ptr<pending_tx> ptx = in_flight.front();
+            in_flight.pop_front();
+
+            tx_verify_result result;
+
+            result.tx_hash = ptx->tx_hash;
+            result.found = ptx->found;
+            result.no_of_rings = ptx->rings.size();
+
+            if (ptx->found)
+            {
+                RingVerifier::collect_results(ptx->rings, ptx->checks,
+                                              ptx->no_of_inputs,
+                                              result.results);
+            }
+
+            ++summary.no_of_txs;
+            summary.no_of_rings += result.no_of_rings;
+
+            if (!result.found)
+            {
+                ++summary.no_of_not_found;
+            }
+            else if (!result.is_valid())
+            {
+                ++summary.no_of_invalid;
+            }
+
+            on_result(result);
+        };
+
+        static StageGauge& hash_queue_depth = StageStats::gauge("batch_hash_queue_depth");
+        static StageGauge& tx_queue_depth = StageStats::gauge("batch_tx_queue_depth");
+        static StageGauge& in_flight_txs = StageStats::gauge("batch_in_flight_txs");
+
+        shared_ptr<pending_tx> ptx;
+
+        try
+        {
+            while (tx_queue.pop(ptx))
+            {
+                set_gauge(hash_queue_depth, hash_queue.size());
+                set_gauge(tx_queue_depth, tx_queue.size());
+
+                if (ptx->found)
+                {
+                    ptx->checks = m_verifier.submit_rings(ptx->tx_prefix_hash,
+                                                          ptx->rings);
+                }
+
+                in_flight.push_back(ptx);
+
+                if (in_flight.size() >= m_queue_size)
+                {
+                    report_oldest();
+                }
+
+                set_gauge(in_flight_txs, in_flight.size());
+            }
+
+            while (!in_flight.empty())
+            {
+                report_oldest();
+            }
+        }
+        catch (...)
+        {
+            // on_result threw. stop the other stages, and wait for
+            // checks still queued in the pool, as they use rings
+            // of the txs in flight.
+            hash_queue.close();
+            tx_queue.close();
+
+            for (const shared_ptr<pending_tx>& p: in_flight)
+            {
+                for (future<bool>& check: p->checks)
+                {
+                    check.wait();
+                }
+            }
+
+            reader.join();
+            fetcher.join();
+
+            throw;
+        }
+
+        reader.join();
+        fetcher.join();
+
+        summary.no_of_unparsed = no_of_unparsed;
+
+        summary.seconds = chrono::duration<double>(
+                chrono::steady_clock::now() - start).count();
+
+        return no_of_unparsed == 0;
+    }
+
+}
@@ -0,0 +1,88 @@
+#ifndef XMREG01_BATCHVERIFIER_H
+#define XMREG01_BATCHVERIFIER_H
+
+#include "MicroCore.h"
+#include "RingVerifier.h"
+#include "BoundedQueue.h"
+
+#include <istream>
+#include <functional>
+
+
+namespace xmreg
+{
+    using namespace cryptonote;
+    using namespace crypto;
+    using namespace std;
+
+
+    /**
+     * Outcome of verifying all rings of one transaction
+     */
+    struct tx_verify_result
+    {
+        crypto::hash tx_hash;
+        bool found {false};
+        size_t no_of_rings {0};
+
+        // one entry per input, 1 if ring signature is valid
+        vector<uint64_t> results;
+
+        bool
+        is_valid() const;
+    };
+
+
+    struct batch_summary
+    {
+        size_t no_of_txs {0};
+        size_t no_of_not_found {0};
+        size_t no_of_invalid {0};
+        size_t no_of_rings {0};
+
+        // lines that are not tx hashes
+        size_t no_of_unparsed {0};
+
+        double seconds {0};
+    };
+
+
+    /**
+     * Verifies a stream of transaction hashes, one per line,
+     * e.g., from a file or stdin.
+     *
+     * Processing is a pipeline of three stages:
+     *
+     *  - reader thread parses hashes,
+     *  - fetch thread reads txs and their rings from the blockchain,
+     *  - the calling thread queues ring checks in RingVerifier's pool
+     *    and reports results, in the input order.
+     *
+     * The stages are connected with BoundedQueues, and the number of
+     * txs being verified at once is limited as well, so memory use
+     * does not depend on the number of hashes.
+     */
+    class BatchVerifier {
+
+        MicroCore& m_mcore;
+        RingVerifier& m_verifier;
+
+        size_t m_queue_size;
+
+    public:
+
+        using result_callback = function<void(const tx_verify_result&)>;
+
+        BatchVerifier(MicroCore& mcore,
+                      RingVerifier& verifier,
+                      size_t queue_size = 256);
+
+        bool
+        run(istream& hashes_stream,
+            const result_callback& on_result,
+            batch_summary& summary);
+    };
+
+}
+
+#endif //XMREG01_BATCHVERIFIER_H
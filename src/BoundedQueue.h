@@ -0,0 +1,114 @@
+#ifndef XMREG01_BOUNDEDQUEUE_H
+#define XMREG01_BOUNDEDQUEUE_H
+
+#include <deque>
+#include <mutex>
+#include <condition_variable>
+
+
+namespace xmreg
+{
+    using namespace std;
+
+    /**
+     * Blocking, fixed capacity queue connecting
+     * stages of a pipeline.
+     *
+     * push() waits while the queue is full, so a fast producer
+     * can't get ahead of a slow consumer by more than the capacity.
+     * After close(), push() fails and pop() returns
+     * false once the queue is drained.
+     */
+    template<typename T>
+    class BoundedQueue {
+
+        deque<T> m_items;
+        size_t m_capacity;
+
+        bool m_closed {false};
+
+        mutable mutex m_mutex;
+        condition_variable m_not_empty;
+        condition_variable m_not_full;
+
+    public:
+
+        explicit BoundedQueue(size_t capacity):
+                m_capacity(capacity > 0 ? capacity : 1)
+        {}
+
+        bool
+        push(T item)
+        {
+            unique_lock<mutex> lock(m_mutex);
+
+            m_not_full.wait(lock, [this] {
+                return m_closed || m_items.size() < m_capacity;
+            });
+
+            if (m_closed)
+            {
+                return false;
+            }
+
+            m_items.push_back(std::move(item));
+
+            lock.unlock();
+            m_not_empty.notify_one();
+
+            return true;
+        }
+
+        bool
+        pop(T& item)
+        {
+            unique_lock<mutex> lock(m_mutex);
+
+            m_not_empty.wait(lock, [this] {
+                return m_closed || !m_items.empty();
+            });
+
+            if (m_items.empty())
+            {
+                // closed and drained
+                return false;
+            }
+
+            item = std::move(m_items.front());
+            m_items.pop_front();
+
+            lock.unlock();
+            m_not_full.notify_one();
+
+            return true;
+        }
+
+        void
+        close()
+        {
+            {
+                lock_guard<mutex> lock(m_mutex);
+                m_closed = true;
+            }
+
+            m_not_empty.notify_all();
+            m_not_full.notify_all();
+        }
+
+        size_t
+        size() const
+        {
+            lock_guard<mutex> lock(m_mutex);
+            return m_items.size();
+        }
+
+        size_t
+        capacity() const
+        {
+            return m_capacity;
+        }
+    };
+
+}
+
+#endif //XMREG01_BOUNDEDQUEUE_H
@@ -0,0 +1,401 @@
+#include "ChainGenerator.h"
+#include "PointCache.h"
+
+#include <set>
+
+
+namespace xmreg
+{
+
+    namespace
+    {
+        const unsigned char*
+        as_bytes(const ec_scalar& s)
+        {
+            return reinterpret_cast<const unsigned char*>(&s);
+        }
+
+        unsigned char*
+        as_bytes(ec_scalar& s)
+        {
+            return reinterpret_cast<unsigned char*>(&s);
+        }
+
+        void
+        hash_to_scalar(const void* data, size_t size, ec_scalar& res)
+        {
+            crypto::hash h;
+
+            cn_fast_hash(data, size, h);
+
+            memcpy(&res, &h, sizeof(res));
+
+            sc_reduce32(as_bytes(res));
+        }
+    }
+
+
+    constexpr uint64_t ChainGenerator::OUTPUT_AMOUNT;
+
+
+    ChainGenerator::ChainGenerator(const chain_generator_config& config):
+            m_config(config), m_rng(config.seed)
+    {}
+
+
+    /**
+     * Generate the chain and write it to a new
+     * database at blockchain_path.
+     *
+     * Fails if the database already has blocks.
+     */
+    bool
+    ChainGenerator::generate(const string& blockchain_path, bool show_progress)
+    {
+        if (m_config.ring_size == 0 || m_config.outputs_per_tx == 0)
+        {
+            cerr << "Ring size and outputs per tx must be above 0" << endl;
+            return false;
+        }
+
+        BlockchainLMDB db;
+
+        try
+        {
+            db.open(blockchain_path);
+
+            if (db.height() != 0)
+            {
+                cerr << "Database at " << blockchain_path
+                     << " is not empty" << endl;
+                return false;
+            }
+
+            crypto::hash prev_id = null_hash;
+
+            uint64_t coins_generated {0};
+
+            for (uint64_t height = 0; height < m_config.no_of_blocks; ++height)
+            {
+                // only outputs from previous blocks can be spent
+                // or used as mixins
+                uint64_t no_of_ring_outputs = m_output_pub_keys.size();
+
+                block blk;
+
+                blk.major_version = 1;
+                blk.minor_version = 0;
+                blk.timestamp     = 1400000000 + height * 60;
+                blk.prev_id       = prev_id;
+                blk.nonce         = 0;
+                blk.miner_tx      = make_coinbase(height);
+
+                vector<transaction> txs;
+
+                size_t block_size = get_object_blobsize(blk.miner_tx);
+
+                for (size_t i = 0; i < m_config.txs_per_block; ++i)
+                {
+                    transaction tx;
+
+                    if (!make_tx(no_of_ring_outputs, tx))
+                    {
+                        // not enough unspent outputs yet
+                        break;
+                    }
+
+                    blk.tx_hashes.push_back(get_transaction_hash(tx));
+                    block_size += get_object_blobsize(tx);
+
+                    txs.push_back(tx);
+                }
+
+                coins_generated += OUTPUT_AMOUNT;
+
+                db.add_block(blk, block_size, height + 1, coins_generated, txs);
+
+                prev_id = get_block_hash(blk);
+
+                if (show_progress && height % 1000 == 0)
+                {
+                    cout << " - generated blocks: " << height << "/"
+                         << m_config.no_of_blocks << "\r" << flush;
+                }
+            }
+
+            db.close();
+        }
+        catch (const std::exception& e)
+        {
+            cerr << "Error writing synthetic chain: " << e.what() << endl;
+            return false;
+        }
+
+        if (show_progress)
+        {
+            cout << endl;
+        }
+
+        return true;
+    }
+
+
+    void
+    ChainGenerator::random_scalar(ec_scalar& res)
+    {
+        uint64_t words[4];
+
+        for (uint64_t& word: words)
+        {
+            word = m_rng();
+        }
+
+        static_assert(sizeof(words) == sizeof(ec_scalar),
+                      "ec_scalar must be 32 bytes");
+
+        memcpy(&res, words, sizeof(res));
+
+        sc_reduce32(as_bytes(res));
+    }
+
+
+    /**
+     * Add output with a new key to the tx, and remember
+     * the key so that the output can be spent later.
+     */
+    void
+    ChainGenerator::new_output(transaction& tx, uint64_t amount)
+    {
+        secret_key sec_key;
+        public_key pub_key;
+
+        random_scalar(sec_key);
+        secret_key_to_public_key(sec_key, pub_key);
+
+        tx_out out;
+
+        out.amount = amount;
+        out.target = txout_to_key {pub_key};
+
+        tx.vout.push_back(out);
+
+        m_output_pub_keys.push_back(pub_key);
+        m_output_sec_keys.push_back(sec_key);
+    }
+
+
+    transaction
+    ChainGenerator::make_coinbase(uint64_t height)
+    {
+        transaction tx;
+
+        tx.version     = 1;
+        tx.unlock_time = height + CRYPTONOTE_MINED_MONEY_UNLOCK_WINDOW;
+
+        txin_gen in;
+        in.height = height;
+
+        tx.vin.push_back(in);
+
+        secret_key tx_sec_key;
+        public_key tx_pub_key;
+
+        random_scalar(tx_sec_key);
+        secret_key_to_public_key(tx_sec_key, tx_pub_key);
+
+        add_tx_pub_key_to_extra(tx, tx_pub_key);
+
+        new_output(tx, OUTPUT_AMOUNT);
+
+        return tx;
+    }
+
+
+    /**
+     * Make tx spending the oldest unspent outputs.
+     *
+     * Ring members are taken from the first
+     * no_of_ring_outputs outputs.
+     */
+    bool
+    ChainGenerator::make_tx(uint64_t no_of_ring_outputs, transaction& tx)
+    {
+        size_t ring_size = m_config.ring_size;
+
+        if (no_of_ring_outputs < ring_size
+            || m_next_unspent + m_config.inputs_per_tx > no_of_ring_outputs)
+        {
+            return false;
+        }
+
+        tx = transaction {};
+
+        tx.version     = 1;
+        tx.unlock_time = 0;
+
+        // real output of each input, as position in its ring
+        vector<size_t> real_indices;
+        vector<uint64_t> real_outputs;
+
+        for (size_t i = 0; i < m_config.inputs_per_tx; ++i)
+        {
+            uint64_t real_output = m_next_unspent++;
+
+            set<uint64_t> ring_outputs {real_output};
+
+            // not uniform_int_distribution, as its results
+            // differ between standard libraries
+            while (ring_outputs.size() < ring_size)
+            {
+                ring_outputs.insert(m_rng() % no_of_ring_outputs);
+            }
+
+            vector<uint64_t> absolute_offsets(ring_outputs.begin(),
+                                              ring_outputs.end());
+
+            txin_to_key in;
+
+            in.amount      = OUTPUT_AMOUNT;
+            in.key_offsets = absolute_output_offsets_to_relative(absolute_offsets);
+
+            generate_key_image(m_output_pub_keys[real_output],
+                               m_output_sec_keys[real_output],
+                               in.k_image);
+
+            tx.vin.push_back(in);
+
+            real_indices.push_back(distance(ring_outputs.begin(),
+                                            ring_outputs.find(real_output)));
+            real_outputs.push_back(real_output);
+        }
+
+        secret_key tx_sec_key;
+        public_key tx_pub_key;
+
+        random_scalar(tx_sec_key);
+        secret_key_to_public_key(tx_sec_key, tx_pub_key);
+
+        add_tx_pub_key_to_extra(tx, tx_pub_key);
+
+        for (size_t i = 0; i < m_config.outputs_per_tx; ++i)
+        {
+            new_output(tx, OUTPUT_AMOUNT);
+        }
+
+        // sign all inputs of the finished prefix
+        crypto::hash prefix_hash = get_transaction_prefix_hash(tx);
+
+        for (size_t i = 0; i < tx.vin.size(); ++i)
+        {
+            const txin_to_key& in = boost::get<txin_to_key>(tx.vin[i]);
+
+            vector<uint64_t> absolute_offsets
+                    = relative_output_offsets_to_absolute(in.key_offsets);
+
+            vector<public_key> pub_keys;
+
+            for (uint64_t output: absolute_offsets)
+            {
+                pub_keys.push_back(m_output_pub_keys[output]);
+            }
+
+            tx.signatures.push_back(vector<signature>(ring_size));
+
+            sign_ring(prefix_hash, in.k_image, pub_keys, real_indices[i],
+                      m_output_sec_keys[real_outputs[i]],
+                      tx.signatures.back().data());
+        }
+
+        return true;
+    }
+
+
+    /**
+     * Same as crypto::generate_ring_signature, but with
+     * the random scalars taken from m_rng, so that
+     * signatures are the same in each run.
+     */
+    void
+    ChainGenerator::sign_ring(const crypto::hash& prefix_hash,
+                              const key_image& image,
+                              const vector<public_key>& pub_keys,
+                              size_t real_index,
+                              const secret_key& sec_key,
+                              signature* signatures)
+    {
+        ge_p3 image_unp;
+        ge_dsmp image_pre;
+
+        ge_frombytes_vartime(&image_unp,
+                             reinterpret_cast<const unsigned char*>(&image));
+        ge_dsm_precomp(image_pre, &image_unp);
+
+        // prefix hash followed by a_i, b_i of each member
+        vector<unsigned char> buf(sizeof(crypto::hash)
+                                  + 2 * sizeof(ec_point) * pub_keys.size());
+
+        memcpy(buf.data(), &prefix_hash, sizeof(crypto::hash));
+
+        unsigned char* ab = buf.data() + sizeof(crypto::hash);
+
+        ec_scalar sum;
+        ec_scalar k;
+
+        sc_0(as_bytes(sum));
+
+        for (size_t i = 0; i < pub_keys.size(); ++i)
+        {
+            ring_member_points points;
+            PointCache::compute_points(pub_keys[i], points);
+
+            ge_p2 tmp2;
+
+            if (i == real_index)
+            {
+                ge_p3 tmp3;
+
+                random_scalar(k);
+
+                ge_scalarmult_base(&tmp3, as_bytes(k));
+                ge_p3_tobytes(ab, &tmp3);
+
+                ge_scalarmult(&tmp2, as_bytes(k), &points.key_hash);
+                ge_tobytes(ab + sizeof(ec_point), &tmp2);
+            }
+            else
+            {
+                signature& sig = signatures[i];
+
+                random_scalar(sig.c);
+                random_scalar(sig.r);
+
+                ge_double_scalarmult_base_vartime(&tmp2, as_bytes(sig.c),
+                                                  &points.pub_key,
+                                                  as_bytes(sig.r));
+                ge_tobytes(ab, &tmp2);
+
+                ge_double_scalarmult_precomp_vartime(&tmp2, as_bytes(sig.r),
+                                                     &points.key_hash,
+                                                     as_bytes(sig.c),
+                                                     image_pre);
+                ge_tobytes(ab + sizeof(ec_point), &tmp2);
+
+                sc_add(as_bytes(sum), as_bytes(sum), as_bytes(sig.c));
+            }
+
+            ab += 2 * sizeof(ec_point);
+        }
+
+        ec_scalar h;
+
+        hash_to_scalar(buf.data(), buf.size(), h);
+
+        signature& real_sig = signatures[real_index];
+
+        // c = h - sum, r = k - c * sec_key
+        sc_sub(as_bytes(real_sig.c), as_bytes(h), as_bytes(sum));
+        sc_mulsub(as_bytes(real_sig.r), as_bytes(real_sig.c),
+                  as_bytes(sec_key), as_bytes(k));
+    }
+
+}
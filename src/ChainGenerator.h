@@ -0,0 +1,93 @@
+#ifndef XMREG01_CHAINGENERATOR_H
+#define XMREG01_CHAINGENERATOR_H
+
+#include "monero_headers.h"
+
+#include <random>
+#include <string>
+#include <vector>
+
+
+namespace xmreg
+{
+    using namespace cryptonote;
+    using namespace crypto;
+    using namespace std;
+
+
+    struct chain_generator_config
+    {
+        uint64_t no_of_blocks {1000};
+        size_t txs_per_block {10};
+        size_t inputs_per_tx {1};
+        size_t ring_size {4};
+        size_t outputs_per_tx {2};
+        uint64_t seed {0};
+    };
+
+
+    /**
+     * Writes a synthetic blockchain into a new lmdb database,
+     * for benchmarks of MicroCore and the verifiers without
+     * a synced node.
+     *
+     * For a given config the chain is always the same: keys,
+     * ring members and ring signature nonces all come from
+     * a std::mt19937_64 seeded with config.seed.
+     *
+     * Each block has a coinbase tx with one output, followed
+     * by up to txs_per_block txs. Each tx spends the oldest unspent
+     * outputs from previous blocks, with randomly chosen mixins,
+     * and has valid ring signatures. All outputs have the same
+     * amount, OUTPUT_AMOUNT, and amounts are not balanced. Blocks
+     * have no proof of work, so Blockchain::init must not be used
+     * on the database, i.e., open it with MicroCore::init with
+     * read_only or without the core.
+     */
+    class ChainGenerator {
+
+        chain_generator_config m_config;
+
+        mt19937_64 m_rng;
+
+        // keys of all outputs, by global output index
+        vector<public_key> m_output_pub_keys;
+        vector<secret_key> m_output_sec_keys;
+
+        uint64_t m_next_unspent {0};
+
+    public:
+
+        static constexpr uint64_t OUTPUT_AMOUNT {1000000000000};
+
+        explicit ChainGenerator(const chain_generator_config& config);
+
+        bool
+        generate(const string& blockchain_path, bool show_progress = true);
+
+    private:
+
+        void
+        random_scalar(ec_scalar& res);
+
+        void
+        new_output(transaction& tx, uint64_t amount);
+
+        transaction
+        make_coinbase(uint64_t height);
+
+        bool
+        make_tx(uint64_t no_of_ring_outputs, transaction& tx);
+
+        void
+        sign_ring(const crypto::hash& prefix_hash,
+                  const key_image& image,
+                  const vector<public_key>& pub_keys,
+                  size_t real_index,
+                  const secret_key& sec_key,
+                  signature* signatures);
+    };
+
+}
+
+#endif //XMREG01_CHAINGENERATOR_H
@@ -30,7 +30,59 @@ namespace xmreg
                 ("address,a", value<string>(),
                  "monero address string")
                 ("bc-path,b", value<string>(),
-                 "path to lmdb blockchain");
+                 "path to lmdb blockchain")
+                ("read-only", value<bool>()->default_value(false)->implicit_value(true),
+                 "open lmdb blockchain read only, so that it can be shared with other processes")
+                ("fast-startup", value<bool>()->default_value(false)->implicit_value(true),
+                 "access lmdb database directly, without initializing cryptonote::Blockchain")
+                ("startup-bench", value<size_t>()->default_value(0),
+                 "open the blockchain this many times with and without Blockchain init, print average times and exit")
+                ("tx-cache-size", value<size_t>()->default_value(10000),
+                 "max number of decoded txs kept in memory, 0 - disable tx cache")
+                ("block-cache-mb", value<size_t>()->default_value(64),
+                 "memory limit of the block cache in MB, 0 - disable block cache")
+                ("verify", value<bool>()->default_value(false)->implicit_value(true),
+                 "only verify ring signature of each input of the tx, and time each check")
+                ("point-cache-mb", value<size_t>()->default_value(0),
+                 "memory limit in MB of decompressed ring member keys kept between ring checks, 0 - disable and use crypto::check_ring_signature")
+                ("stats", value<bool>()->default_value(false)->implicit_value(true),
+                 "print time spent in each stage, e.g., get_tx or check_ring_signature, at exit")
+                ("stats-json", value<string>(),
+                 "write stage timings with latency histograms as json to this file at exit")
+                ("metrics-port", value<size_t>()->default_value(0),
+                 "serve stage metrics in Prometheus text format on http://127.0.0.1:port/metrics, 0 - disable")
+                ("metrics-file", value<string>(),
+                 "rewrite stage metrics in Prometheus text format to this file, e.g., for node_exporter's textfile collector")
+                ("metrics-interval", value<size_t>()->default_value(10),
+                 "seconds between rewrites of metrics-file")
+                ("threads,n", value<size_t>()->default_value(0),
+                 "number of threads verifying ring signatures, 0 - use all cores")
+                ("output-index", value<bool>()->default_value(false)->implicit_value(true),
+                 "build/update output public key index and use it to find mixins' txs")
+                ("output-index-path", value<string>(),
+                 "path to output index, default is next to lmdb blockchain folder")
+                ("server", value<bool>()->default_value(false)->implicit_value(true),
+                 "keep the blockchain open and serve verify/inspect json requests on a unix socket")
+                ("socket", value<string>(),
+                 "path of the unix socket used in server mode, default is next to lmdb blockchain folder")
+                ("tx-file", value<string>(),
+                 "file with tx hashes to verify, one per line, - to read from stdin")
+                ("queue-size", value<size_t>()->default_value(256),
+                 "max number of txs kept in each stage of --tx-file processing")
+                ("scan-outputs", value<bool>()->default_value(false)->implicit_value(true),
+                 "find outputs of --address using --viewkey in blocks from --start-height to --end-height")
+                ("csv-out", value<string>(),
+                 "with --scan-outputs, write outputs found to this csv file")
+                ("binary-out", value<string>(),
+                 "with --start-height, dump verified rings to this binary columnar file")
+                ("binary-in", value<string>(),
+                 "print rings of a file written with --binary-out, without opening the blockchain")
+                ("accounts-file", value<string>(),
+                 "scan for outputs of many accounts at once, one \"<address> <viewkey> [label]\" per line")
+                ("start-height", value<size_t>(),
+                 "verify all rings in blocks starting from this height")
+                ("end-height", value<size_t>(),
+                 "last block height to verify with --start-height, default is the top block");
 
 
         store(command_line_parser(acc, avv)
@@ -0,0 +1,188 @@
+#ifndef XMREG01_LRUCACHE_H
+#define XMREG01_LRUCACHE_H
+
+#include <list>
+#include <unordered_map>
+#include <mutex>
+#include <atomic>
+#include <functional>
+
+
+namespace xmreg
+{
+    using namespace std;
+
+    /**
+     * Thread safe, least recently used cache.
+     *
+     * Each entry has a cost given in put(), e.g., 1 to limit
+     * the number of entries, or its size in bytes to limit
+     * memory. When total cost goes above max_cost, least
+     * recently used entries are removed. max_cost of 0
+     * disables the cache.
+     *
+     * Values are returned by copy, so for big objects
+     * V should be a shared_ptr.
+     */
+    template<typename K, typename V, typename Hash = std::hash<K>>
+    class LruCache {
+
+        struct entry
+        {
+            K key;
+            V value;
+            size_t cost;
+        };
+
+        // most recently used at the front
+        list<entry> m_items;
+
+        unordered_map<K, typename list<entry>::iterator, Hash> m_index;
+
+        size_t m_max_cost;
+        size_t m_cost {0};
+
+        mutable mutex m_mutex;
+
+        atomic<uint64_t> m_hits {0};
+        atomic<uint64_t> m_misses {0};
+
+    public:
+
+        explicit LruCache(size_t max_cost = 0):
+                m_max_cost(max_cost)
+        {}
+
+        LruCache(const LruCache&) = delete;
+        LruCache& operator=(const LruCache&) = delete;
+
+        bool
+        get(const K& key, V& value)
+        {
+            lock_guard<mutex> lock(m_mutex);
+
+            auto it = m_index.find(key);
+
+            if (it == m_index.end())
+            {
+                ++m_misses;
+                return false;
+            }
+
+            // move the entry to the front
+            m_items.splice(m_items.begin(), m_items, it->second);
+
+            value = it->second->value;
+
+            ++m_hits;
+
+            return true;
+        }
+
+        void
+        put(const K& key, V value, size_t cost = 1)
+        {
+            lock_guard<mutex> lock(m_mutex);
+
+            if (cost > m_max_cost)
+            {
+                return;
+            }
+
+            auto it = m_index.find(key);
+
+            if (it != m_index.end())
+            {
+                m_cost -= it->second->cost;
+                m_items.erase(it->second);
+                m_index.erase(it);
+            }
+
+            m_items.push_front(entry {key, std::move(value), cost});
+            m_index[key] = m_items.begin();
+
+            m_cost += cost;
+
+            evict();
+        }
+
+        void
+        set_max_cost(size_t max_cost)
+        {
+            lock_guard<mutex> lock(m_mutex);
+
+            m_max_cost = max_cost;
+
+            evict();
+        }
+
+        void
+        clear()
+        {
+            lock_guard<mutex> lock(m_mutex);
+
+            m_items.clear();
+            m_index.clear();
+            m_cost = 0;
+        }
+
+        size_t
+        size() const
+        {
+            lock_guard<mutex> lock(m_mutex);
+            return m_items.size();
+        }
+
+        size_t
+        cost() const
+        {
+            lock_guard<mutex> lock(m_mutex);
+            return m_cost;
+        }
+
+        size_t
+        max_cost() const
+        {
+            lock_guard<mutex> lock(m_mutex);
+            return m_max_cost;
+        }
+
+        uint64_t
+        hits() const
+        {
+            return m_hits;
+        }
+
+        uint64_t
+        misses() const
+        {
+            return m_misses;
+        }
+
+        double
+        hit_rate() const
+        {
+            uint64_t total = hits() + misses();
+            return total > 0 ? static_cast<double>(hits()) / total : 0.0;
+        }
+
+    private:
+
+        // must be called with m_mutex locked
+        void
+        evict()
+        {
+            while (m_cost > m_max_cost && !m_items.empty())
+            {
+                const entry& last = m_items.back();
+
+                m_cost -= last.cost;
+                m_index.erase(last.key);
+                m_items.pop_back();
+            }
+        }
+    };
+
+}
+
+#endif //XMREG01_LRUCACHE_H
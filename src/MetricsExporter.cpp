@@ -0,0 +1,242 @@
+#include "MetricsExporter.h"
+
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+
+
+namespace xmreg
+{
+
+    using asio::ip::tcp;
+
+
+    constexpr size_t MetricsExporter::MAX_REQUEST_SIZE;
+    constexpr long MetricsExporter::REQUEST_TIMEOUT;
+
+
+    /**
+     * Start serving metrics over http on the loopback interface
+     */
+    bool
+    MetricsExporter::serve(uint16_t port)
+    {
+        try
+        {
+            m_acceptor.reset(new tcp::acceptor(
+                    m_io_service,
+                    tcp::endpoint(asio::ip::address_v4::loopback(), port)));
+        }
+        catch (const exception& e)
+        {
+            cerr << "Cant listen for metrics on port " << port
+                 << ": " << e.what() << endl;
+            return false;
+        }
+
+        accept_next();
+
+        m_http_thread = thread([this]
+        {
+            m_io_service.run();
+        });
+
+        cout << "Serving metrics on: http://127.0.0.1:" << port << "/metrics" << endl;
+
+        return true;
+    }
+
+
+    void
+    MetricsExporter::accept_next()
+    {
+        auto socket = make_shared<tcp::socket>(m_io_service);
+
+        m_acceptor->async_accept(*socket, [this, socket](
+                const boost::system::error_code& ec)
+        {
+            if (ec)
+            {
+                // e.g., io service stopped by stop()
+                return;
+            }
+
+            handle_connection(socket);
+
+            accept_next();
+        });
+    }
+
+
+    /**
+     * Any request gets the metrics, whatever the path.
+     *
+     * Everything is asynchronous, so that a slow client does not
+     * hold up others, nor stop(). A client gets REQUEST_TIMEOUT
+     * seconds to send at most MAX_REQUEST_SIZE bytes of request
+     * headers and read the response, otherwise it is disconnected.
+     */
+    void
+    MetricsExporter::handle_connection(shared_ptr<tcp::socket> socket)
+    {
+        auto request = make_shared<asio::streambuf>(MAX_REQUEST_SIZE);
+
+        auto deadline = make_shared<asio::deadline_timer>(
+                m_io_service, boost::posix_time::seconds(REQUEST_TIMEOUT));
+
+        deadline->async_wait([socket](const boost::system::error_code& ec)
+        {
+            if (!ec)
+            {
+                // pending read or write fails with operation_aborted
+                boost::system::error_code ignored;
+                socket->close(ignored);
+            }
+        });
+
+        asio::async_read_until(*socket, *request, "\r\n\r\n",
+                               [socket, request, deadline](
+                                       const boost::system::error_code& ec,
+                                       size_t)
+        {
+            if (ec)
+            {
+                // e.g., timeout, or request too large
+                deadline->cancel();
+                return;
+            }
+
+            stringstream body;
+
+            StageStats::write_prometheus(body);
+
+            string body_str = body.str();
+
+            auto response = make_shared<string>(
+                    "HTTP/1.0 200 OK\r\n"
+                    "Content-Type: text/plain; version=0.0.4\r\n"
+                    "Content-Length: " + to_string(body_str.size()) + "\r\n"
+                    "Connection: close\r\n"
+                    "\r\n" + body_str);
+
+            asio::async_write(*socket, asio::buffer(*response),
+                              [socket, response, deadline](
+                                      const boost::system::error_code&,
+                                      size_t)
+            {
+                deadline->cancel();
+
+                boost::system::error_code ignored;
+                socket->shutdown(tcp::socket::shutdown_both, ignored);
+                socket->close(ignored);
+            });
+        });
+    }
+
+
+    /**
+     * Write metrics to path now, and then every
+     * interval_seconds, and once more on stop()
+     */
+    bool
+    MetricsExporter::write_to_file(const string& path, size_t interval_seconds)
+    {
+        if (!write_file(path))
+        {
+            return false;
+        }
+
+        m_file_path = path;
+        m_interval  = chrono::seconds(interval_seconds > 0 ? interval_seconds : 1);
+
+        m_file_thread = thread([this]
+        {
+            unique_lock<mutex> lock(m_mutex);
+
+            while (!m_stop_cv.wait_for(lock, m_interval, [this] { return m_stop; }))
+            {
+                write_file(m_file_path);
+            }
+        });
+
+        return true;
+    }
+
+
+    /**
+     * Write to a temporary file first, so that
+     * readers never see a partly written file
+     */
+    bool
+    MetricsExporter::write_file(const string& path)
+    {
+        string tmp_path = path + ".tmp";
+
+        {
+            ofstream out {tmp_path};
+
+            if (!out)
+            {
+                cerr << "Cant open metrics file: " << tmp_path << endl;
+                return false;
+            }
+
+            StageStats::write_prometheus(out);
+
+            if (!out)
+            {
+                cerr << "Cant write metrics file: " << tmp_path << endl;
+                return false;
+            }
+        }
+
+        if (rename(tmp_path.c_str(), path.c_str()) != 0)
+        {
+            cerr << "Cant rename " << tmp_path << " to " << path << endl;
+            return false;
+        }
+
+        return true;
+    }
+
+
+    void
+    MetricsExporter::stop()
+    {
+        {
+            lock_guard<mutex> lock(m_mutex);
+
+            if (m_stop)
+            {
+                return;
+            }
+
+            m_stop = true;
+        }
+
+        m_stop_cv.notify_all();
+
+        if (m_file_thread.joinable())
+        {
+            m_file_thread.join();
+
+            // final values
+            write_file(m_file_path);
+        }
+
+        if (m_http_thread.joinable())
+        {
+            m_io_service.stop();
+
+            m_http_thread.join();
+        }
+    }
+
+
+    MetricsExporter::~MetricsExporter()
+    {
+        stop();
+    }
+
+}
@@ -0,0 +1,80 @@
+#ifndef XMREG01_METRICSEXPORTER_H
+#define XMREG01_METRICSEXPORTER_H
+
+#include "StageStats.h"
+
+#include <boost/asio.hpp>
+
+#include <condition_variable>
+#include <string>
+#include <thread>
+
+
+namespace xmreg
+{
+    using namespace std;
+
+    namespace asio = boost::asio;
+
+
+    /**
+     * Exports StageStats in Prometheus text format while
+     * a long running mode (e.g., --start-height scan) works.
+     *
+     * serve() answers every http request on 127.0.0.1:port with
+     * the current metrics. write_to_file() rewrites the file
+     * every interval seconds, e.g., for node_exporter's
+     * textfile collector. Both run in their own threads,
+     * until stop() or destruction.
+     */
+    class MetricsExporter {
+
+        // limits of each http client, see handle_connection
+        static constexpr size_t MAX_REQUEST_SIZE {8192};
+        static constexpr long REQUEST_TIMEOUT {5};
+
+        asio::io_service m_io_service;
+        unique_ptr<asio::ip::tcp::acceptor> m_acceptor;
+        thread m_http_thread;
+
+        string m_file_path;
+        chrono::seconds m_interval {10};
+        thread m_file_thread;
+
+        mutex m_mutex;
+        condition_variable m_stop_cv;
+        bool m_stop {false};
+
+    public:
+
+        MetricsExporter() = default;
+
+        MetricsExporter(const MetricsExporter&) = delete;
+        MetricsExporter& operator=(const MetricsExporter&) = delete;
+
+        bool
+        serve(uint16_t port);
+
+        bool
+        write_to_file(const string& path, size_t interval_seconds = 10);
+
+        void
+        stop();
+
+        ~MetricsExporter();
+
+    private:
+
+        void
+        accept_next();
+
+        void
+        handle_connection(shared_ptr<asio::ip::tcp::socket> socket);
+
+        static bool
+        write_file(const string& path);
+    };
+
+}
+
+#endif //XMREG01_METRICSEXPORTER_H
@@ -3,6 +3,7 @@
 //
 
 #include "MicroCore.h"
+#include "StageStats.h"
 
 namespace xmreg
 {
@@ -18,33 +19,81 @@ namespace xmreg
      *
      * The same is done in cryptonode::core.
      */
-    MicroCore::MicroCore():
+    MicroCore::core_storage::core_storage():
             m_mempool(m_blockchain_storage),
             m_blockchain_storage(m_mempool)
     {}
 
 
+    constexpr size_t MicroCore::DEFAULT_TX_CACHE_SIZE;
+    constexpr size_t MicroCore::DEFAULT_BLOCK_CACHE_SIZE;
+
+
+    MicroCore::MicroCore()
+    {
+        m_cache_gauges.emplace_back(new GaugeCallback("tx_cache_entries", [this]
+        {
+            return static_cast<double>(m_tx_cache.size());
+        }));
+
+        m_cache_gauges.emplace_back(new GaugeCallback("tx_cache_hit_ratio", [this]
+        {
+            return m_tx_cache.hit_rate();
+        }));
+
+        m_cache_gauges.emplace_back(new GaugeCallback("block_cache_bytes", [this]
+        {
+            return static_cast<double>(m_block_cache.cost());
+        }));
+
+        m_cache_gauges.emplace_back(new GaugeCallback("block_cache_hit_ratio", [this]
+        {
+            return m_block_cache.hit_rate();
+        }));
+    }
+
+
     /**
      * Initialized the MicroCore object.
      *
      * Create BlockchainLMDB on the heap.
      * Open database files located in blockchain_path.
      * Initialize m_blockchain_storage with the BlockchainLMDB object.
+     *
+     * In read only mode, the lmdb environment is opened
+     * with MDB_RDONLY, so that many processes can read the
+     * database while monero daemon is writing to it.
+     * Blockchain::init is skipped, as it is only needed by
+     * a writer (e.g., it adds genesis block to an empty
+     * database). All reads done by MicroCore go directly to
+     * the BlockchainDB, thus get_core() must not be
+     * used in this mode.
+     *
+     * If with_core is false, the mempool and Blockchain are not
+     * even constructed, which saves most of the startup time.
+     * Read only mode implies with_core = false.
      */
     bool
-    MicroCore::init(const string& blockchain_path)
+    MicroCore::init(const string& blockchain_path,
+                    bool read_only,
+                    bool with_core)
     {
         int db_flags = 0;
 
-        //db_flags |= MDB_RDONLY ;
+        if (read_only)
+        {
+            // MDB_NOLOCK is not used, as without the reader
+            // lock table a running daemon could reuse pages
+            // that we are still reading.
+            db_flags |= MDB_RDONLY;
+        }
 
-        BlockchainDB* db = nullptr;
-        db = new BlockchainLMDB();
+        m_db = new BlockchainLMDB();
 
         try
         {
             // try opening lmdb database files
-            db->open(blockchain_path, db_flags);
+            m_db->open(blockchain_path, db_flags);
         }
         catch (const std::exception& e)
         {
@@ -54,24 +103,66 @@ namespace xmreg
 
         // check if the blockchain database
         // is successful opened
-        if(!db->is_open())
+        if(!m_db->is_open())
         {
             return false;
         }
 
+        m_read_only = read_only;
+
+        if (read_only || !with_core)
+        {
+            return true;
+        }
+
+        m_core.reset(new core_storage());
+
         // initialize Blockchain object to manage
         // the database.
-        return m_blockchain_storage.init(db, false);
+        return m_core->m_blockchain_storage.init(m_db, false);
     }
 
     /**
     * Get m_blockchain_storage.
     * Initialize m_blockchain_storage with the BlockchainLMDB object.
+    *
+    * Throws if MicroCore was initialized without the core.
     */
     Blockchain&
     MicroCore::get_core()
     {
-        return m_blockchain_storage;
+        if (!m_core)
+        {
+            throw runtime_error("MicroCore initialized without Blockchain");
+        }
+
+        return m_core->m_blockchain_storage;
+    }
+
+
+    bool
+    MicroCore::has_core() const
+    {
+        return static_cast<bool>(m_core);
+    }
+
+
+    /**
+     * Get the blockchain database.
+     *
+     * Available in both, normal and read only mode.
+     */
+    BlockchainDB&
+    MicroCore::get_db()
+    {
+        return *m_db;
+    }
+
+
+    bool
+    MicroCore::is_read_only() const
+    {
+        return m_read_only;
     }
 
     /**
@@ -82,12 +173,34 @@ namespace xmreg
     bool
     MicroCore::get_block_by_height(const uint64_t& height, block& blk)
     {
-
         crypto::hash block_id;
 
+        return get_block_by_height(height, blk, block_id);
+    }
+
+
+    /**
+     * Get block and its hash by block's height
+     *
+     * Blocks are served from the block cache if possible.
+     * Ring members cluster in recent blocks, so the same
+     * blocks are requested many times.
+     *
+     * The hash of the block at the height is always read from
+     * the database, and the cache is keyed by it, so a reorg
+     * in a live database does not give stale blocks.
+     */
+    bool
+    MicroCore::get_block_by_height(const uint64_t& height,
+                                   block& blk,
+                                   crypto::hash& block_id)
+    {
+        static StageTimer& timer = StageStats::timer("get_block");
+        ScopedTimer scoped_timer {timer};
+
         try
         {
-            block_id = m_blockchain_storage.get_block_id_by_height(height);
+            block_id = m_db->get_block_hash_from_height(height);
         }
         catch (const exception& e)
         {
@@ -95,19 +208,70 @@ namespace xmreg
             return false;
         }
 
+        shared_ptr<const cached_block> cblk;
 
-        if (!m_blockchain_storage.get_block_by_hash(block_id, blk))
+        if (m_block_cache.get(block_id, cblk))
+        {
+            blk = cblk->blk;
+
+            return true;
+        }
+
+
+        try
+        {
+            blk = m_db->get_block(block_id);
+        }
+        catch (const exception& e)
         {
             cerr << "Block with hash " << block_id
-                 << "and height " << height << " not found!"
-                 << endl;
+                 << "and height " << height << " not found: "
+                 << e.what() << endl;
             return false;
         }
 
+        cblk = make_shared<const cached_block>(cached_block {blk});
+
+        m_block_cache.put(block_id, cblk, cblk->size());
+
         return true;
     }
 
 
+    /**
+     * Rough estimate of memory used by a cached block
+     */
+    size_t
+    MicroCore::cached_block::size() const
+    {
+        size_t total = sizeof(cached_block)
+                       + blk.tx_hashes.size() * sizeof(crypto::hash)
+                       + blk.miner_tx.extra.size()
+                       + blk.miner_tx.vin.size() * sizeof(txin_v)
+                       + blk.miner_tx.vout.size() * sizeof(tx_out);
+
+        return total;
+    }
+
+
+    /**
+     * Set memory limit, in bytes, of the block cache.
+     * 0 disables the cache.
+     */
+    void
+    MicroCore::set_block_cache_size(size_t no_of_bytes)
+    {
+        m_block_cache.set_max_cost(no_of_bytes);
+    }
+
+
+    const MicroCore::block_cache_t&
+    MicroCore::get_block_cache() const
+    {
+        return m_block_cache;
+    }
+
+
 
     /**
      * Get transaction tx from the blockchain using it hash
@@ -115,10 +279,35 @@ namespace xmreg
     bool
     MicroCore::get_tx(const crypto::hash& tx_hash, transaction& tx)
     {
+        shared_ptr<const transaction> tx_ptr;
+
+        if (!get_tx(tx_hash, tx_ptr))
+        {
+            return false;
+        }
+
+        tx = *tx_ptr;
+
+        return true;
+    }
+
+
+    /**
+     * Same as above, but shares the decoded tx with the
+     * tx cache instead of copying it. The tx must not be
+     * modified, as it may be returned to other callers.
+     */
+    bool
+    MicroCore::get_tx(const crypto::hash& tx_hash,
+                      shared_ptr<const transaction>& tx)
+    {
+        static StageTimer& timer = StageStats::timer("get_tx");
+        ScopedTimer scoped_timer {timer};
+
         try
         {
             // get transaction with given hash
-            tx = m_blockchain_storage.get_db().get_tx(tx_hash);
+            tx = read_tx(tx_hash);
         }
         catch (const exception& e)
         {
@@ -132,6 +321,54 @@ namespace xmreg
 
 
 
+    /**
+     * Get decoded transaction from the tx cache, or
+     * from the database if not cached.
+     *
+     * With cache_tx false, a tx read from the database is
+     * not added to the cache.
+     *
+     * Throws if the tx can't be read from the database.
+     */
+    shared_ptr<const transaction>
+    MicroCore::read_tx(const crypto::hash& tx_hash, bool cache_tx)
+    {
+        shared_ptr<const transaction> tx;
+
+        if (m_tx_cache.get(tx_hash, tx))
+        {
+            return tx;
+        }
+
+        tx = make_shared<const transaction>(m_db->get_tx(tx_hash));
+
+        if (cache_tx)
+        {
+            m_tx_cache.put(tx_hash, tx);
+        }
+
+        return tx;
+    }
+
+
+    /**
+     * Set max number of decoded transactions kept in
+     * the tx cache. 0 disables the cache.
+     */
+    void
+    MicroCore::set_tx_cache_size(size_t no_of_txs)
+    {
+        m_tx_cache.set_max_cost(no_of_txs);
+    }
+
+
+    const MicroCore::tx_cache_t&
+    MicroCore::get_tx_cache() const
+    {
+        return m_tx_cache;
+    }
+
+
     /**
      * Find output with given public key in a given transaction
      */
@@ -172,9 +409,85 @@ namespace xmreg
     }
 
 
+    /**
+     * Get all transactions in a given block,
+     * starting with its coinbase transaction.
+     *
+     * Txs are shared with the tx cache instead of copied.
+     * Sequential scans, which read each tx only once, should
+     * set cache_txs to false, so that they don't evict txs
+     * that are read again, e.g., of ring members.
+     */
+    bool
+    MicroCore::get_block_txs(const block& blk,
+                             vector<shared_ptr<const transaction>>& txs,
+                             bool cache_txs)
+    {
+        // initialize the list with transaction for solving
+        // the block i.e. coinbase.
+        txs.clear();
+        txs.reserve(blk.tx_hashes.size() + 1);
+        txs.push_back(make_shared<const transaction>(blk.miner_tx));
+
+        list<crypto::hash> missed_txs;
+
+        for (const crypto::hash& tx_hash: blk.tx_hashes)
+        {
+            try
+            {
+                txs.push_back(read_tx(tx_hash, cache_txs));
+            }
+            catch (const TX_DNE& e)
+            {
+                missed_txs.push_back(tx_hash);
+            }
+            catch (const exception& e)
+            {
+                cerr << "Cant find transcations in block: "
+                     << get_block_hash(blk) << ": " << e.what() << endl;
+                return false;
+            }
+        }
+
+        if (!missed_txs.empty())
+        {
+            cerr << "Transactions not found in blk: "
+                 << get_block_hash(blk) << endl;
+
+            for (const crypto::hash& h : missed_txs)
+            {
+                cerr << " - tx hash: " << h << endl;
+            }
+
+            return false;
+        }
+
+        return true;
+    }
+
+
+    /**
+     * Use given output index in get_tx_hash_from_output_pubkey
+     * instead of searching through blocks.
+     *
+     * nullptr disables the index.
+     */
+    void
+    MicroCore::set_output_index(const OutputIndex* output_index)
+    {
+        m_output_index = output_index;
+    }
+
+
     /**
      * Returns tx hash in a given block which
      * contains given output's public key
+     *
+     * If output index was set and it contains the output,
+     * the tx is read directly. Otherwise, all transactions
+     * in the block are searched. So are they if the tx from
+     * the index is not in the blockchain, or does not have the
+     * output, e.g., its block was popped in a reorg.
      */
     bool
     MicroCore::get_tx_hash_from_output_pubkey(const public_key& output_pubkey,
@@ -182,9 +495,33 @@ namespace xmreg
                                               crypto::hash& tx_hash,
                                               cryptonote::transaction& tx_found)
     {
+        static StageTimer& timer = StageStats::timer("find_output_tx");
+        static StageCounter& index_hits = StageStats::counter("find_output_tx.index_hits");
+        static StageCounter& block_scans = StageStats::counter("find_output_tx.block_scans");
+
+        ScopedTimer scoped_timer {timer};
 
         tx_hash = null_hash;
 
+        output_location location;
+
+        if (m_output_index && m_output_index->find(output_pubkey, location)
+            && m_db->tx_exists(location.tx_hash)
+            && get_tx(location.tx_hash, tx_found)
+            && location.out_idx < tx_found.vout.size()
+            && tx_found.vout[location.out_idx].target.type() == typeid(txout_to_key)
+            && boost::get<txout_to_key>(
+                    tx_found.vout[location.out_idx].target).key == output_pubkey)
+        {
+            count_stage(index_hits);
+
+            tx_hash = location.tx_hash;
+
+            return true;
+        }
+
+        count_stage(block_scans);
+
         // get block of given height
         block blk;
         if (!get_block_by_height(block_height, blk))
@@ -194,34 +531,19 @@ namespace xmreg
         }
 
 
-        // get all transactions in the block found
-        // initialize the first list with transaction for solving
-        // the block i.e. coinbase.
-        list<transaction> txs {blk.miner_tx};
-        list<crypto::hash> missed_txs;
+        // get all transactions in the block found. they
+        // are kept in the cache, as mixins are often reused
+        vector<shared_ptr<const transaction>> txs;
 
-        if (!m_blockchain_storage.get_transactions(blk.tx_hashes, txs, missed_txs))
-        {
-            cerr << "Cant find transcations in block: " << block_height << endl;
-            return false;
-        }
-
-        if (!missed_txs.empty())
+        if (!get_block_txs(blk, txs))
         {
-            cerr << "Transactions not found in blk: " << block_height << endl;
-
-            for (const crypto::hash& h : missed_txs)
-            {
-                cerr << " - tx hash: " << h << endl;
-            }
-
             return false;
         }
 
 
         // search outputs in each transactions
         // until output with pubkey of interest is found
-        for (const transaction& tx : txs)
+        for (const shared_ptr<const transaction>& tx : txs)
         {
 
             tx_out found_out;
@@ -229,11 +551,12 @@ namespace xmreg
             // we dont need here output_index
             size_t output_index;
 
-            if (find_output_in_tx(tx, output_pubkey, found_out, output_index))
+            if (find_output_in_tx(*tx, output_pubkey, found_out, output_index))
             {
-                // we found the desired public key
-                tx_hash = get_transaction_hash(tx);
-                tx_found = tx;
+                // we found the desired public key, and
+                // copy only this tx
+                tx_hash = get_transaction_hash(*tx);
+                tx_found = *tx;
 
                 return true;
             }
@@ -267,6 +590,60 @@ namespace xmreg
     }
 
 
+    /**
+     * Check many ring signatures in one call.
+     *
+     * Bit i of the returned bitset is set if
+     * records[i] holds a valid ring signature.
+     *
+     * The array of public key pointers required by
+     * crypto::check_ring_signature is allocated once
+     * and reused for all the records in the batch.
+     */
+    boost::dynamic_bitset<>
+    MicroCore::check_ring_signatures(const ring_signature_record* records,
+                                     size_t no_of_records)
+    {
+        boost::dynamic_bitset<> results(no_of_records);
+
+        std::vector<const crypto::public_key *> p_output_keys;
+
+        for (size_t i = 0; i < no_of_records; ++i)
+        {
+            const ring_signature_record& record = records[i];
+
+            if (record.ring_size == 0)
+            {
+                continue;
+            }
+
+            // resize does not free memory, so after first few records
+            // there are no more allocations in this loop
+            p_output_keys.resize(record.ring_size);
+
+            for (size_t k = 0; k < record.ring_size; ++k)
+            {
+                p_output_keys[k] = &record.pub_keys[k];
+            }
+
+            results[i] = crypto::check_ring_signature(*record.tx_prefix_hash,
+                                                      *record.key_image,
+                                                      p_output_keys.data(),
+                                                      record.ring_size,
+                                                      record.signatures);
+        }
+
+        return results;
+    }
+
+
+    boost::dynamic_bitset<>
+    MicroCore::check_ring_signatures(const vector<ring_signature_record>& records)
+    {
+        return check_ring_signatures(records.data(), records.size());
+    }
+
+
 
 
 
@@ -279,6 +656,9 @@ namespace xmreg
      */
     MicroCore::~MicroCore()
     {
-        delete &m_blockchain_storage.get_db();
+        // Blockchain must go before the database it uses
+        m_core.reset();
+
+        delete m_db;
     }
 }
\ No newline at end of file
@@ -6,9 +6,15 @@
 #define XMREG01_MICROCORE_H
 
 #include <iostream>
+#include <memory>
+
+#include <boost/dynamic_bitset.hpp>
 
 #include "monero_headers.h"
 #include "tx_details.h"
+#include "OutputIndex.h"
+#include "LruCache.h"
+#include "StageStats.h"
 
 
 
@@ -18,6 +24,21 @@ namespace xmreg
     using namespace crypto;
     using namespace std;
 
+    /**
+     * Non-owning view of the data needed to check
+     * one ring signature. The pointed to data must
+     * outlive the batch check.
+     */
+    struct ring_signature_record
+    {
+        const crypto::hash* tx_prefix_hash;
+        const crypto::key_image* key_image;
+        const crypto::public_key* pub_keys;
+        const crypto::signature* signatures;
+        size_t ring_size;
+    };
+
+
     /**
      * Micro version of cryptonode::core class
      * Micro version of constructor,
@@ -28,24 +49,121 @@ namespace xmreg
      */
     class MicroCore {
 
-        tx_memory_pool m_mempool;
-        Blockchain m_blockchain_storage;
+        /**
+         * Mempool and Blockchain pair, as in cryptonode::core.
+         *
+         * Constructed only when the full core is requested
+         * in init(). Reading the database does not need them.
+         */
+        struct core_storage
+        {
+            tx_memory_pool m_mempool;
+            Blockchain m_blockchain_storage;
+
+            core_storage();
+        };
+
+        unique_ptr<core_storage> m_core;
+
+        // owned, created in init()
+        BlockchainDB* m_db {nullptr};
+
+        bool m_read_only {false};
+
+        // optional, not owned
+        const OutputIndex* m_output_index {nullptr};
+
+    public:
+
+        /**
+         * Block as kept in the block cache
+         */
+        struct cached_block
+        {
+            block blk;
+
+            size_t
+            size() const;
+        };
+
+        using tx_cache_t = LruCache<crypto::hash, shared_ptr<const transaction>>;
+
+        using block_cache_t = LruCache<crypto::hash, shared_ptr<const cached_block>>;
+
+        static constexpr size_t DEFAULT_TX_CACHE_SIZE {10000};
+
+        // in bytes
+        static constexpr size_t DEFAULT_BLOCK_CACHE_SIZE {64 * 1024 * 1024};
+
+    private:
+
+        // decoded txs by their hash. popular mixins appear in
+        // many rings, so their txs are read over and over again.
+        tx_cache_t m_tx_cache {DEFAULT_TX_CACHE_SIZE};
+
+        // decoded blocks by their hash, limited by memory used.
+        // not by height, so that after a reorg the new
+        // blocks are read, not the popped ones.
+        block_cache_t m_block_cache {DEFAULT_BLOCK_CACHE_SIZE};
+
+        // cache sizes and hit rates for metrics, must be
+        // declared after the caches
+        vector<unique_ptr<GaugeCallback>> m_cache_gauges;
 
     public:
         MicroCore();
 
         bool
-        init(const string& blockchain_path);
+        init(const string& blockchain_path,
+             bool read_only = false,
+             bool with_core = true);
 
         Blockchain&
         get_core();
 
+        BlockchainDB&
+        get_db();
+
+        bool
+        is_read_only() const;
+
+        bool
+        has_core() const;
+
         bool
         get_block_by_height(const uint64_t& height, block& blk);
 
+        bool
+        get_block_by_height(const uint64_t& height,
+                            block& blk,
+                            crypto::hash& block_id);
+
         bool
         get_tx(const crypto::hash& tx_hash, transaction& tx);
 
+        bool
+        get_tx(const crypto::hash& tx_hash, shared_ptr<const transaction>& tx);
+
+        bool
+        get_block_txs(const block& blk,
+                      vector<shared_ptr<const transaction>>& txs,
+                      bool cache_txs = true);
+
+        void
+        set_tx_cache_size(size_t no_of_txs);
+
+        const tx_cache_t&
+        get_tx_cache() const;
+
+        void
+        set_block_cache_size(size_t no_of_bytes);
+
+        const block_cache_t&
+        get_block_cache() const;
+
+        void
+        set_output_index(const OutputIndex* output_index);
+
         bool
         find_output_in_tx(const transaction& tx,
                           const public_key& output_pubkey,
@@ -65,7 +183,19 @@ namespace xmreg
                              const std::vector<crypto::signature>& sig,
                              uint64_t &result);
 
+        boost::dynamic_bitset<>
+        check_ring_signatures(const ring_signature_record* records,
+                              size_t no_of_records);
+
+        boost::dynamic_bitset<>
+        check_ring_signatures(const vector<ring_signature_record>& records);
+
         virtual ~MicroCore();
+
+    private:
+
+        shared_ptr<const transaction>
+        read_tx(const crypto::hash& tx_hash, bool cache_tx = true);
     };
 
 }
@@ -0,0 +1,282 @@
+#include "MultiAccountScanner.h"
+#include "tools.h"
+
+#include <algorithm>
+#include <fstream>
+#include <sstream>
+#include <chrono>
+
+
+namespace xmreg
+{
+
+    MultiAccountScanner::MultiAccountScanner(MicroCore& mcore):
+            m_mcore(mcore)
+    {}
+
+
+    /**
+     * Add an account to watch.
+     *
+     * Returns false if an account with the same view
+     * and spend keys is already watched.
+     */
+    bool
+    MultiAccountScanner::add_account(const watched_account& account)
+    {
+        auto group_it = std::find_if(m_groups.begin(), m_groups.end(),
+                                     [&](const view_key_group& g)
+                                     {
+                                         return g.private_view_key
+                                                == account.private_view_key;
+                                     });
+
+        if (group_it == m_groups.end())
+        {
+            m_groups.push_back(view_key_group {account.private_view_key, {}});
+            group_it = m_groups.end() - 1;
+        }
+
+        const public_key& spend_key = account.address.m_spend_public_key;
+
+        if (group_it->spend_keys.count(spend_key))
+        {
+            return false;
+        }
+
+        group_it->spend_keys[spend_key] = m_accounts.size();
+
+        m_accounts.push_back(account);
+
+        return true;
+    }
+
+
+    /**
+     * Load accounts from a text file with one account per line:
+     *
+     *   <address> <private view key> [label]
+     *
+     * Empty lines and lines starting with # are skipped.
+     */
+    bool
+    MultiAccountScanner::load_accounts(const string& accounts_file)
+    {
+        ifstream in(accounts_file);
+
+        if (!in)
+        {
+            cerr << "Cant open accounts file: " << accounts_file << endl;
+            return false;
+        }
+
+        string line;
+        size_t line_no {0};
+
+        while (getline(in, line))
+        {
+            ++line_no;
+
+            istringstream iss(line);
+
+            string address_str;
+            string viewkey_str;
+            string label;
+
+            if (!(iss >> address_str) || address_str[0] == '#')
+            {
+                continue;
+            }
+
+            watched_account account;
+
+            if (!(iss >> viewkey_str)
+                || !parse_str_address(address_str, account.address)
+                || !parse_str_secret_key(viewkey_str, account.private_view_key))
+            {
+                cerr << "Cant parse account in line " << line_no
+                     << " of " << accounts_file << endl;
+                return false;
+            }
+
+            getline(iss >> ws, label);
+
+            account.label = label.empty() ? address_str : label;
+
+            if (!add_account(account))
+            {
+                cerr << "Duplicate account in line " << line_no
+                     << " of " << accounts_file << endl;
+            }
+        }
+
+        return true;
+    }
+
+
+    const vector<watched_account>&
+    MultiAccountScanner::get_accounts() const
+    {
+        return m_accounts;
+    }
+
+
+    size_t
+    MultiAccountScanner::no_of_view_keys() const
+    {
+        return m_groups.size();
+    }
+
+
+    /**
+     * Scan blocks from start_height to end_height, inclusive,
+     * for outputs of all the accounts.
+     */
+    bool
+    MultiAccountScanner::scan(uint64_t start_height,
+                              uint64_t end_height,
+                              const output_callback& on_output,
+                              output_scan_summary& summary)
+    {
+        summary = output_scan_summary {};
+
+        uint64_t blockchain_height = m_mcore.get_db().height();
+
+        if (blockchain_height == 0 || start_height >= blockchain_height)
+        {
+            cerr << "Start height " << start_height
+                 << " is above blockchain height "
+                 << blockchain_height << endl;
+            return false;
+        }
+
+        end_height = std::min(end_height, blockchain_height - 1);
+
+        auto start = chrono::steady_clock::now();
+
+        vector<account_output> outputs;
+
+        for (uint64_t h = start_height; h <= end_height; ++h)
+        {
+            block blk;
+            vector<shared_ptr<const transaction>> txs;
+
+            if (!m_mcore.get_block_by_height(h, blk)
+                || !m_mcore.get_block_txs(blk, txs, false))
+            {
+                return false;
+            }
+
+            outputs.clear();
+
+            scan_block(blk, txs, h, outputs);
+
+            ++summary.no_of_blocks;
+            summary.no_of_txs += txs.size();
+
+            for (const shared_ptr<const transaction>& tx: txs)
+            {
+                summary.no_of_outputs += tx->vout.size();
+            }
+
+            for (const account_output& out: outputs)
+            {
+                on_output(out);
+            }
+        }
+
+        summary.seconds = chrono::duration<double>(
+                chrono::steady_clock::now() - start).count();
+
+        return true;
+    }
+
+
+    /**
+     * Check all outputs of all txs in a block against
+     * all the watched accounts.
+     *
+     * txs must be as returned by MicroCore::get_block_txs.
+     */
+    void
+    MultiAccountScanner::scan_block(const block& blk,
+                                    const vector<shared_ptr<const transaction>>& txs,
+                                    uint64_t block_height,
+                                    vector<account_output>& outputs) const
+    {
+        size_t tx_i {0};
+
+        for (const shared_ptr<const transaction>& tx_ptr: txs)
+        {
+            const transaction& tx = *tx_ptr;
+
+            public_key pub_tx_key = get_tx_pub_key_from_extra(tx);
+
+            if (pub_tx_key == null_pkey || tx.vout.empty())
+            {
+                ++tx_i;
+                continue;
+            }
+
+            // computed only if one of the outputs is ours
+            crypto::hash tx_hash = null_hash;
+
+            for (const view_key_group& group: m_groups)
+            {
+                key_derivation derivation;
+
+                if (!generate_key_derivation(pub_tx_key,
+                                             group.private_view_key,
+                                             derivation))
+                {
+                    continue;
+                }
+
+                for (size_t i = 0; i < tx.vout.size(); ++i)
+                {
+                    if (tx.vout[i].target.type() != typeid(txout_to_key))
+                    {
+                        continue;
+                    }
+
+                    const txout_to_key& tx_out_to_key
+                            = boost::get<txout_to_key>(tx.vout[i].target);
+
+                    public_key spend_key;
+
+                    if (!derive_spend_public_key(derivation, i,
+                                                 tx_out_to_key.key,
+                                                 spend_key))
+                    {
+                        continue;
+                    }
+
+                    auto it = group.spend_keys.find(spend_key);
+
+                    if (it == group.spend_keys.end())
+                    {
+                        continue;
+                    }
+
+                    if (tx_hash == null_hash)
+                    {
+                        tx_hash = tx_i == 0 || tx_i > blk.tx_hashes.size()
+                                  ? get_transaction_hash(tx)
+                                  : blk.tx_hashes[tx_i - 1];
+                    }
+
+                    outputs.push_back(account_output {
+                            it->second,
+                            transfer_details {block_height,
+                                              blk.timestamp,
+                                              tx_hash, i,
+                                              tx.vout[i].amount,
+                                              false}});
+                }
+            }
+
+            ++tx_i;
+        }
+    }
+
+}
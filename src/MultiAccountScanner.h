@@ -0,0 +1,95 @@
+#ifndef XMREG01_MULTIACCOUNTSCANNER_H
+#define XMREG01_MULTIACCOUNTSCANNER_H
+
+#include "MicroCore.h"
+#include "ParallelOutputScanner.h"
+
+#include <unordered_map>
+#include <functional>
+
+
+namespace xmreg
+{
+    using namespace cryptonote;
+    using namespace crypto;
+    using namespace std;
+
+
+    struct watched_account
+    {
+        string label;
+        account_public_address address;
+        secret_key private_view_key;
+    };
+
+
+    /**
+     * Output found to belong to one of the watched accounts
+     */
+    struct account_output
+    {
+        size_t account_index;
+        transfer_details output;
+    };
+
+
+    /**
+     * Finds outputs of many accounts in a single pass over
+     * the blockchain.
+     *
+     * Accounts are grouped by private view key. For each tx and
+     * view key the derivation is computed once. Then, for each output,
+     * public spend key is recovered from the output key (see
+     * derive_spend_public_key) and looked up in the group's hash map.
+     * Thus, checking an output costs one lookup no matter how
+     * many accounts share the view key.
+     */
+    class MultiAccountScanner {
+
+        struct view_key_group
+        {
+            secret_key private_view_key;
+
+            // public spend key -> index in m_accounts
+            unordered_map<public_key, size_t> spend_keys;
+        };
+
+        MicroCore& m_mcore;
+
+        vector<watched_account> m_accounts;
+        vector<view_key_group> m_groups;
+
+    public:
+
+        using output_callback = function<void(const account_output&)>;
+
+        explicit MultiAccountScanner(MicroCore& mcore);
+
+        bool
+        add_account(const watched_account& account);
+
+        bool
+        load_accounts(const string& accounts_file);
+
+        const vector<watched_account>&
+        get_accounts() const;
+
+        size_t
+        no_of_view_keys() const;
+
+        bool
+        scan(uint64_t start_height,
+             uint64_t end_height,
+             const output_callback& on_output,
+             output_scan_summary& summary);
+
+        void
+        scan_block(const block& blk,
+                   const vector<shared_ptr<const transaction>>& txs,
+                   uint64_t block_height,
+                   vector<account_output>& outputs) const;
+    };
+
+}
+
+#endif //XMREG01_MULTIACCOUNTSCANNER_H
@@ -0,0 +1,513 @@
+#include "OutputIndex.h"
+#include "MicroCore.h"
+
+#include <boost/filesystem.hpp>
+
+
+namespace xmreg
+{
+
+    namespace
+    {
+        // key in m_meta_dbi under which the next
+        // height to be indexed is kept
+        const char HEIGHT_KEY[] = "height";
+
+        // key of the hash of the last indexed block
+        const char TOP_HASH_KEY[] = "top_hash";
+
+        // 64 GB. lmdb only reserves address space,
+        // the file grows with the data written.
+        const size_t INDEX_MAP_SIZE {size_t(1) << 36};
+    }
+
+
+    constexpr uint64_t OutputIndex::BLOCKS_PER_TXN;
+
+
+    /**
+     * Open (or create if not read only)
+     * the index environment in the index_path folder.
+     */
+    bool
+    OutputIndex::open(const string& index_path, bool read_only)
+    {
+        close();
+
+        m_read_only = read_only;
+
+        if (!read_only)
+        {
+            boost::system::error_code ec;
+            boost::filesystem::create_directories(index_path, ec);
+
+            if (ec)
+            {
+                cerr << "Cant create output index folder "
+                     << index_path << ": " << ec.message() << endl;
+                return false;
+            }
+        }
+
+        int rc;
+
+        if ((rc = mdb_env_create(&m_env)) != MDB_SUCCESS)
+        {
+            cerr << "Cant create output index environment: "
+                 << mdb_strerror(rc) << endl;
+            m_env = nullptr;
+            return false;
+        }
+
+        mdb_env_set_maxdbs(m_env, 2);
+        mdb_env_set_mapsize(m_env, INDEX_MAP_SIZE);
+
+        // MDB_NOTLS allows read transactions to be
+        // used by verification threads
+        unsigned int env_flags = MDB_NOTLS;
+
+        if (read_only)
+        {
+            env_flags |= MDB_RDONLY;
+        }
+
+        if ((rc = mdb_env_open(m_env, index_path.c_str(), env_flags, 0644))
+            != MDB_SUCCESS)
+        {
+            cerr << "Cant open output index " << index_path << ": "
+                 << mdb_strerror(rc) << endl;
+            close();
+            return false;
+        }
+
+        MDB_txn* txn;
+
+        if ((rc = mdb_txn_begin(m_env, nullptr, read_only ? MDB_RDONLY : 0, &txn))
+            != MDB_SUCCESS)
+        {
+            cerr << "Cant start output index transaction: "
+                 << mdb_strerror(rc) << endl;
+            close();
+            return false;
+        }
+
+        unsigned int dbi_flags = read_only ? 0 : MDB_CREATE;
+
+        if ((rc = mdb_dbi_open(txn, "outputs", dbi_flags, &m_outputs_dbi))
+                != MDB_SUCCESS
+            || (rc = mdb_dbi_open(txn, "meta", dbi_flags, &m_meta_dbi))
+                != MDB_SUCCESS)
+        {
+            cerr << "Cant open output index tables: "
+                 << mdb_strerror(rc) << endl;
+            mdb_txn_abort(txn);
+            close();
+            return false;
+        }
+
+        if ((rc = mdb_txn_commit(txn)) != MDB_SUCCESS)
+        {
+            cerr << "Cant commit output index tables: "
+                 << mdb_strerror(rc) << endl;
+            close();
+            return false;
+        }
+
+        return true;
+    }
+
+
+    bool
+    OutputIndex::is_open() const
+    {
+        return m_env != nullptr;
+    }
+
+
+    /**
+     * Index all blocks from the last indexed height
+     * up to the current blockchain height.
+     *
+     * Every BLOCKS_PER_TXN blocks are written, together with
+     * the new height, in one lmdb transaction. Thus an interrupted
+     * update loses at most the blocks of the last transaction,
+     * and those are indexed again in the next update.
+     */
+    bool
+    OutputIndex::update(MicroCore& mcore, bool show_progress)
+    {
+        if (!is_open() || m_read_only)
+        {
+            cerr << "Output index is not open for writing" << endl;
+            return false;
+        }
+
+        uint64_t blockchain_height = mcore.get_db().height();
+
+        uint64_t block_height = height();
+
+        if (block_height > 0 && !matches(mcore))
+        {
+            // popped blocks cant be read, so it is not known
+            // which outputs to remove. start again instead.
+            cout << "Output index does not match the blockchain, "
+                 << "e.g., after a reorg, rebuilding it" << endl;
+
+            if (!clear())
+            {
+                return false;
+            }
+
+            block_height = 0;
+        }
+
+        if (show_progress && block_height < blockchain_height)
+        {
+            cout << "Updating output index from height "
+                 << block_height << " to " << blockchain_height << endl;
+        }
+
+        while (block_height < blockchain_height)
+        {
+            uint64_t last_height = std::min(block_height + BLOCKS_PER_TXN,
+                                            blockchain_height);
+
+            MDB_txn* txn;
+
+            int rc = mdb_txn_begin(m_env, nullptr, 0, &txn);
+
+            if (rc != MDB_SUCCESS)
+            {
+                cerr << "Cant start output index transaction: "
+                     << mdb_strerror(rc) << endl;
+                return false;
+            }
+
+            crypto::hash top_hash;
+
+            for (uint64_t h = block_height; h < last_height; ++h)
+            {
+                if (!index_block(txn, mcore, h, top_hash))
+                {
+                    mdb_txn_abort(txn);
+                    return false;
+                }
+            }
+
+            if (!put_height(txn, last_height, top_hash))
+            {
+                mdb_txn_abort(txn);
+                return false;
+            }
+
+            if ((rc = mdb_txn_commit(txn)) != MDB_SUCCESS)
+            {
+                cerr << "Cant commit output index transaction: "
+                     << mdb_strerror(rc) << endl;
+                return false;
+            }
+
+            block_height = last_height;
+
+            if (show_progress)
+            {
+                cout << " - indexed blocks up to: " << block_height
+                     << "/" << blockchain_height << "\r" << flush;
+            }
+        }
+
+        if (show_progress)
+        {
+            cout << endl;
+        }
+
+        return true;
+    }
+
+
+    /**
+     * Find the transaction and vout index of an
+     * output with the given public key
+     */
+    bool
+    OutputIndex::find(const public_key& output_pubkey,
+                      output_location& location) const
+    {
+        if (!is_open())
+        {
+            return false;
+        }
+
+        MDB_txn* txn;
+
+        if (mdb_txn_begin(m_env, nullptr, MDB_RDONLY, &txn) != MDB_SUCCESS)
+        {
+            return false;
+        }
+
+        MDB_val key {sizeof(output_pubkey),
+                     const_cast<public_key*>(&output_pubkey)};
+        MDB_val value;
+
+        bool found {false};
+
+        if (mdb_get(txn, m_outputs_dbi, &key, &value) == MDB_SUCCESS
+            && value.mv_size == sizeof(output_location))
+        {
+            memcpy(&location, value.mv_data, sizeof(output_location));
+            found = true;
+        }
+
+        mdb_txn_abort(txn);
+
+        return found;
+    }
+
+
+    /**
+     * Height of the first block not yet in the index
+     */
+    uint64_t
+    OutputIndex::height() const
+    {
+        uint64_t next_height {0};
+
+        if (!get_meta(HEIGHT_KEY, sizeof(HEIGHT_KEY),
+                      &next_height, sizeof(next_height)))
+        {
+            return 0;
+        }
+
+        return next_height;
+    }
+
+
+    /**
+     * Check if the last indexed block is still in the
+     * blockchain, i.e., all indexed outputs are in it.
+     *
+     * An empty index always matches. An index written before
+     * the top block hash was kept never does.
+     */
+    bool
+    OutputIndex::matches(MicroCore& mcore) const
+    {
+        uint64_t next_height = height();
+
+        if (next_height == 0)
+        {
+            return true;
+        }
+
+        crypto::hash top_hash;
+
+        if (next_height > mcore.get_db().height()
+            || !get_meta(TOP_HASH_KEY, sizeof(TOP_HASH_KEY),
+                         &top_hash, sizeof(top_hash)))
+        {
+            return false;
+        }
+
+        try
+        {
+            return mcore.get_db().get_block_hash_from_height(next_height - 1)
+                   == top_hash;
+        }
+        catch (const exception&)
+        {
+            return false;
+        }
+    }
+
+
+    void
+    OutputIndex::close()
+    {
+        if (m_env)
+        {
+            mdb_env_close(m_env);
+            m_env = nullptr;
+        }
+    }
+
+
+    /**
+     * Default location of the index, i.e., next to the lmdb
+     * blockchain folder, e.g., ~/.bitmonero/rings_output_index
+     */
+    string
+    OutputIndex::get_default_path(const string& blockchain_path)
+    {
+        boost::filesystem::path bc_path {blockchain_path};
+
+        return (bc_path.parent_path() / "rings_output_index").string();
+    }
+
+
+    OutputIndex::~OutputIndex()
+    {
+        close();
+    }
+
+
+    /**
+     * Add all outputs of all transactions,
+     * including coinbase, in a given block
+     */
+    bool
+    OutputIndex::index_block(MDB_txn* txn, MicroCore& mcore, uint64_t block_height,
+                             crypto::hash& block_hash)
+    {
+        block blk;
+
+        if (!mcore.get_block_by_height(block_height, blk, block_hash))
+        {
+            cerr << "Cant get block of height: " << block_height << endl;
+            return false;
+        }
+
+        vector<shared_ptr<const transaction>> txs;
+
+        if (!mcore.get_block_txs(blk, txs, false))
+        {
+            return false;
+        }
+
+        for (const shared_ptr<const transaction>& tx_ptr: txs)
+        {
+            const transaction& tx = *tx_ptr;
+
+            output_location location {get_transaction_hash(tx), 0};
+
+            for (; location.out_idx < tx.vout.size(); ++location.out_idx)
+            {
+                const tx_out& out = tx.vout[location.out_idx];
+
+                if (out.target.type() != typeid(txout_to_key))
+                {
+                    continue;
+                }
+
+                const txout_to_key& tx_out_to_key
+                        = boost::get<txout_to_key>(out.target);
+
+                MDB_val key {sizeof(tx_out_to_key.key),
+                             const_cast<public_key*>(&tx_out_to_key.key)};
+                MDB_val value {sizeof(location), &location};
+
+                int rc = mdb_put(txn, m_outputs_dbi, &key, &value, 0);
+
+                if (rc != MDB_SUCCESS)
+                {
+                    cerr << "Cant add output " << tx_out_to_key.key
+                         << " to output index: " << mdb_strerror(rc) << endl;
+                    return false;
+                }
+            }
+        }
+
+        return true;
+    }
+
+
+    bool
+    OutputIndex::put_height(MDB_txn* txn, uint64_t next_height,
+                            const crypto::hash& top_hash)
+    {
+        MDB_val key {sizeof(HEIGHT_KEY), const_cast<char*>(HEIGHT_KEY)};
+        MDB_val value {sizeof(next_height), &next_height};
+
+        int rc = mdb_put(txn, m_meta_dbi, &key, &value, 0);
+
+        if (rc == MDB_SUCCESS)
+        {
+            key = MDB_val {sizeof(TOP_HASH_KEY), const_cast<char*>(TOP_HASH_KEY)};
+            value = MDB_val {sizeof(top_hash), const_cast<crypto::hash*>(&top_hash)};
+
+            rc = mdb_put(txn, m_meta_dbi, &key, &value, 0);
+        }
+
+        if (rc != MDB_SUCCESS)
+        {
+            cerr << "Cant save output index height: "
+                 << mdb_strerror(rc) << endl;
+            return false;
+        }
+
+        return true;
+    }
+
+
+    /**
+     * Read a fixed size value from m_meta_dbi
+     */
+    bool
+    OutputIndex::get_meta(const char* key_data, size_t key_size,
+                          void* value_data, size_t value_size) const
+    {
+        if (!is_open())
+        {
+            return false;
+        }
+
+        MDB_txn* txn;
+
+        if (mdb_txn_begin(m_env, nullptr, MDB_RDONLY, &txn) != MDB_SUCCESS)
+        {
+            return false;
+        }
+
+        MDB_val key {key_size, const_cast<char*>(key_data)};
+        MDB_val value;
+
+        bool found {false};
+
+        if (mdb_get(txn, m_meta_dbi, &key, &value) == MDB_SUCCESS
+            && value.mv_size == value_size)
+        {
+            memcpy(value_data, value.mv_data, value_size);
+            found = true;
+        }
+
+        mdb_txn_abort(txn);
+
+        return found;
+    }
+
+
+    /**
+     * Remove all outputs and the height
+     */
+    bool
+    OutputIndex::clear()
+    {
+        MDB_txn* txn;
+
+        int rc;
+
+        if ((rc = mdb_txn_begin(m_env, nullptr, 0, &txn)) != MDB_SUCCESS)
+        {
+            cerr << "Cant start output index transaction: "
+                 << mdb_strerror(rc) << endl;
+            return false;
+        }
+
+        if ((rc = mdb_drop(txn, m_outputs_dbi, 0)) != MDB_SUCCESS
+            || (rc = mdb_drop(txn, m_meta_dbi, 0)) != MDB_SUCCESS)
+        {
+            cerr << "Cant clear output index: " << mdb_strerror(rc) << endl;
+            mdb_txn_abort(txn);
+            return false;
+        }
+
+        if ((rc = mdb_txn_commit(txn)) != MDB_SUCCESS)
+        {
+            cerr << "Cant commit cleared output index: "
+                 << mdb_strerror(rc) << endl;
+            return false;
+        }
+
+        return true;
+    }
+
+}
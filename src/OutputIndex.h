@@ -0,0 +1,109 @@
+#ifndef XMREG01_OUTPUTINDEX_H
+#define XMREG01_OUTPUTINDEX_H
+
+#include "monero_headers.h"
+
+#include <string>
+
+
+namespace xmreg
+{
+    using namespace cryptonote;
+    using namespace crypto;
+    using namespace std;
+
+    class MicroCore;
+
+
+    /**
+     * Location of an output in the blockchain,
+     * i.e., hash of its transaction and its index
+     * in the transaction's vout.
+     */
+    struct output_location
+    {
+        crypto::hash tx_hash;
+        uint64_t out_idx;
+    };
+
+
+    /**
+     * Side index mapping output public keys
+     * to output_location.
+     *
+     * It is kept in its own lmdb environment, separate
+     * from the blockchain, so the blockchain database
+     * is never written to. The index remembers up to which
+     * height it was built, so update() only needs to
+     * process blocks added since the last run.
+     *
+     * It also remembers the hash of its top block. If the
+     * blockchain no longer has that block, e.g., after a reorg,
+     * matches() is false and update() rebuilds the index.
+     */
+    class OutputIndex {
+
+        MDB_env* m_env {nullptr};
+
+        MDB_dbi m_outputs_dbi;
+        MDB_dbi m_meta_dbi;
+
+        bool m_read_only {false};
+
+    public:
+
+        // number of blocks indexed in one write transaction
+        static constexpr uint64_t BLOCKS_PER_TXN {1000};
+
+        OutputIndex() = default;
+
+        OutputIndex(const OutputIndex&) = delete;
+        OutputIndex& operator=(const OutputIndex&) = delete;
+
+        bool
+        open(const string& index_path, bool read_only = false);
+
+        bool
+        is_open() const;
+
+        bool
+        update(MicroCore& mcore, bool show_progress = true);
+
+        bool
+        find(const public_key& output_pubkey, output_location& location) const;
+
+        uint64_t
+        height() const;
+
+        bool
+        matches(MicroCore& mcore) const;
+
+        void
+        close();
+
+        static string
+        get_default_path(const string& blockchain_path);
+
+        ~OutputIndex();
+
+    private:
+
+        bool
+        index_block(MDB_txn* txn, MicroCore& mcore, uint64_t block_height,
+                    crypto::hash& block_hash);
+
+        bool
+        put_height(MDB_txn* txn, uint64_t next_height,
+                   const crypto::hash& top_hash);
+
+        bool
+        get_meta(const char* key, size_t key_size,
+                 void* value, size_t value_size) const;
+
+        bool
+        clear();
+    };
+
+}
+
+#endif //XMREG01_OUTPUTINDEX_H
@@ -0,0 +1,203 @@
+#include "OutputKeyResolver.h"
+#include "StageStats.h"
+
+#include <algorithm>
+
+
+namespace xmreg
+{
+
+    OutputKeyResolver::OutputKeyResolver(BlockchainDB& db):
+            m_db(db)
+    {}
+
+
+    void
+    OutputKeyResolver::add(uint64_t amount,
+                           const vector<uint64_t>& absolute_offsets)
+    {
+        for (uint64_t index: absolute_offsets)
+        {
+            m_outputs.push_back(output_entry {amount, index, {}});
+        }
+
+        m_resolved = false;
+    }
+
+
+    /**
+     * Add ring members of all txin_to_key inputs of the tx
+     */
+    void
+    OutputKeyResolver::add_tx(const transaction& tx)
+    {
+        for (const txin_v& tx_in: tx.vin)
+        {
+            if (tx_in.type() != typeid(txin_to_key))
+            {
+                continue;
+            }
+
+            const txin_to_key& tx_in_to_key = boost::get<txin_to_key>(tx_in);
+
+            add(tx_in_to_key.amount,
+                relative_output_offsets_to_absolute(tx_in_to_key.key_offsets));
+        }
+    }
+
+
+    /**
+     * Read outputs of all added (amount, index) pairs.
+     *
+     * Each distinct amount takes one get_output_key call
+     * with sorted and unique indices, so that lmdb's cursor
+     * moves forward through its pages, rather than jumping
+     * around as when each input is read on its own.
+     */
+    bool
+    OutputKeyResolver::resolve()
+    {
+        static StageCounter& calls = StageStats::counter("get_output_key.calls");
+        static StageCounter& unique_outputs = StageStats::counter("get_output_key.outputs");
+
+        if (m_resolved)
+        {
+            return true;
+        }
+
+        sort(m_outputs.begin(), m_outputs.end(),
+             [](const output_entry& a, const output_entry& b)
+             {
+                 return a.amount != b.amount
+                        ? a.amount < b.amount
+                        : a.index < b.index;
+             });
+
+        // the same output is often used in many rings of a block
+        m_outputs.erase(unique(m_outputs.begin(), m_outputs.end(),
+                               [](const output_entry& a, const output_entry& b)
+                               {
+                                   return a.amount == b.amount
+                                          && a.index == b.index;
+                               }),
+                        m_outputs.end());
+
+        vector<uint64_t> indices;
+        vector<output_data_t> outputs;
+
+        auto first = m_outputs.begin();
+
+        while (first != m_outputs.end())
+        {
+            uint64_t amount = first->amount;
+
+            auto last = find_if(first, m_outputs.end(),
+                                [amount](const output_entry& e)
+                                {
+                                    return e.amount != amount;
+                                });
+
+            indices.clear();
+            outputs.clear();
+
+            for (auto it = first; it != last; ++it)
+            {
+                indices.push_back(it->index);
+            }
+
+            try
+            {
+                m_db.get_output_key(amount, indices, outputs);
+            }
+            catch (const exception& e)
+            {
+                cerr << "Cant get outputs of amount " << amount
+                     << ": " << e.what() << endl;
+                return false;
+            }
+
+            if (outputs.size() != indices.size())
+            {
+                cerr << "Got " << outputs.size() << " outputs of amount "
+                     << amount << " instead of " << indices.size() << endl;
+                return false;
+            }
+
+            for (size_t i = 0; i < outputs.size(); ++i)
+            {
+                first[i].data = outputs[i];
+            }
+
+            count_stage(calls);
+            count_stage(unique_outputs, outputs.size());
+
+            first = last;
+        }
+
+        m_resolved = true;
+
+        return true;
+    }
+
+
+    /**
+     * Outputs of the given indices, in the given
+     * order. Only valid after resolve().
+     */
+    bool
+    OutputKeyResolver::get(uint64_t amount,
+                           const vector<uint64_t>& absolute_offsets,
+                           vector<output_data_t>& outputs) const
+    {
+        outputs.clear();
+
+        if (!m_resolved)
+        {
+            cerr << "Outputs are not resolved" << endl;
+            return false;
+        }
+
+        outputs.reserve(absolute_offsets.size());
+
+        for (uint64_t index: absolute_offsets)
+        {
+            auto it = lower_bound(m_outputs.begin(), m_outputs.end(),
+                                  make_pair(amount, index),
+                                  [](const output_entry& e,
+                                     const pair<uint64_t, uint64_t>& key)
+                                  {
+                                      return e.amount != key.first
+                                             ? e.amount < key.first
+                                             : e.index < key.second;
+                                  });
+
+            if (it == m_outputs.end()
+                || it->amount != amount || it->index != index)
+            {
+                cerr << "Output " << index << " of amount "
+                     << amount << " was not added" << endl;
+                return false;
+            }
+
+            outputs.push_back(it->data);
+        }
+
+        return true;
+    }
+
+
+    size_t
+    OutputKeyResolver::size() const
+    {
+        return m_outputs.size();
+    }
+
+
+    void
+    OutputKeyResolver::clear()
+    {
+        m_outputs.clear();
+        m_resolved = false;
+    }
+
+}
@@ -0,0 +1,74 @@
+#ifndef XMREG01_OUTPUTKEYRESOLVER_H
+#define XMREG01_OUTPUTKEYRESOLVER_H
+
+#include "monero_headers.h"
+
+#include <vector>
+
+
+namespace xmreg
+{
+    using namespace cryptonote;
+    using namespace crypto;
+    using namespace std;
+
+
+    /**
+     * Reads ring members' outputs of many inputs, e.g., of
+     * all txs in a block, with as few database calls as possible.
+     *
+     * (amount, global index) pairs of all inputs are first
+     * collected with add(), then resolve() sorts them, drops
+     * duplicates, and reads each amount's indices in ascending
+     * order in a single get_output_key call. Finally, get()
+     * returns the outputs of each input in its ring order.
+     *
+     *   OutputKeyResolver resolver {mcore.get_db()};
+     *   resolver.add_tx(tx);
+     *   resolver.resolve();
+     *   resolver.get(amount, absolute_offsets, outputs);
+     */
+    class OutputKeyResolver {
+
+        struct output_entry
+        {
+            uint64_t amount;
+            uint64_t index;
+            output_data_t data;
+        };
+
+        BlockchainDB& m_db;
+
+        // sorted by amount and index after resolve()
+        vector<output_entry> m_outputs;
+
+        bool m_resolved {false};
+
+    public:
+
+        explicit OutputKeyResolver(BlockchainDB& db);
+
+        void
+        add(uint64_t amount, const vector<uint64_t>& absolute_offsets);
+
+        void
+        add_tx(const transaction& tx);
+
+        bool
+        resolve();
+
+        bool
+        get(uint64_t amount,
+            const vector<uint64_t>& absolute_offsets,
+            vector<output_data_t>& outputs) const;
+
+        size_t
+        size() const;
+
+        void
+        clear();
+    };
+
+}
+
+#endif //XMREG01_OUTPUTKEYRESOLVER_H
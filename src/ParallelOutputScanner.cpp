@@ -0,0 +1,284 @@
+#include "ParallelOutputScanner.h"
+
+#include <map>
+#include <chrono>
+#include <exception>
+
+
+namespace xmreg
+{
+
+    namespace
+    {
+        struct scanned_chunk
+        {
+            vector<transfer_details> outputs;
+            output_scan_summary summary;
+        };
+    }
+
+
+    ParallelOutputScanner::ParallelOutputScanner(
+            MicroCore& mcore,
+            const secret_key& private_view_key,
+            const public_key& public_spend_key,
+            size_t no_of_threads,
+            uint64_t chunk_size,
+            size_t max_chunks_ahead):
+            m_mcore(mcore),
+            m_private_view_key(private_view_key),
+            m_public_spend_key(public_spend_key),
+            m_no_of_threads(no_of_threads > 0
+                            ? no_of_threads
+                            : ThreadPool::default_size()),
+            m_chunk_size(chunk_size > 0 ? chunk_size : 1),
+            m_max_chunks_ahead(max_chunks_ahead > 0
+                               ? max_chunks_ahead
+                               : 4 * m_no_of_threads)
+    {}
+
+
+    /**
+     * Scan blocks from start_height to end_height, inclusive.
+     *
+     * end_height is limited to the top block. Returns false
+     * if the range is empty.
+     */
+    bool
+    ParallelOutputScanner::scan(uint64_t start_height,
+                                uint64_t end_height,
+                                const output_callback& on_output,
+                                output_scan_summary& summary)
+    {
+        summary = output_scan_summary {};
+
+        uint64_t blockchain_height = m_mcore.get_db().height();
+
+        if (blockchain_height == 0 || start_height >= blockchain_height)
+        {
+            cerr << "Start height " << start_height
+                 << " is above blockchain height "
+                 << blockchain_height << endl;
+            return false;
+        }
+
+        end_height = std::min(end_height, blockchain_height - 1);
+
+        // otherwise the number of chunks below wraps around
+        if (end_height < start_height)
+        {
+            cerr << "End height " << end_height
+                 << " is below start height " << start_height << endl;
+            return false;
+        }
+
+        auto start = chrono::steady_clock::now();
+
+        const size_t no_of_chunks
+                = (end_height - start_height) / m_chunk_size + 1;
+
+        mutex chunks_mutex;
+        condition_variable chunks_cv;
+
+        // guarded by chunks_mutex
+        size_t next_to_claim {0};
+        size_t next_to_report {0};
+        bool failed {false};
+        map<size_t, scanned_chunk> done_chunks;
+
+        // first exception thrown by a worker or by on_output,
+        // rethrown once all workers are finished.
+        // guarded by chunks_mutex
+        exception_ptr error;
+
+        auto fail = [&](exception_ptr e)
+        {
+            {
+                lock_guard<mutex> lock(chunks_mutex);
+
+                failed = true;
+
+                if (!error)
+                {
+                    error = e;
+                }
+            }
+
+            chunks_cv.notify_all();
+        };
+
+        // BlockchainLMDB is not meant to be used from many threads
+        // at once, so blocks are read one worker at a time.
+        // Derivations, which are the expensive part, run in parallel.
+        mutex db_mutex;
+
+        auto scan_chunk = [&](size_t chunk_no, scanned_chunk& chunk)
+        {
+            uint64_t first_height = start_height + chunk_no * m_chunk_size;
+            uint64_t last_height = std::min(first_height + m_chunk_size - 1,
+                                            end_height);
+
+            for (uint64_t h = first_height; h <= last_height; ++h)
+            {
+                block blk;
+                vector<shared_ptr<const transaction>> txs;
+
+                // only pointers to the txs are taken under the lock
+                {
+                    lock_guard<mutex> db_lock(db_mutex);
+
+                    if (!m_mcore.get_block_by_height(h, blk)
+                        || !m_mcore.get_block_txs(blk, txs, false))
+                    {
+                        return false;
+                    }
+                }
+
+                vector<transfer_details> block_outputs
+                        = get_belonging_outputs(blk, txs,
+                                                m_private_view_key,
+                                                m_public_spend_key,
+                                                h);
+
+                std::move(block_outputs.begin(), block_outputs.end(),
+                          back_inserter(chunk.outputs));
+
+                ++chunk.summary.no_of_blocks;
+                chunk.summary.no_of_txs += txs.size();
+
+                for (const shared_ptr<const transaction>& tx: txs)
+                {
+                    chunk.summary.no_of_outputs += tx->vout.size();
+                }
+            }
+
+            return true;
+        };
+
+        auto worker = [&]
+        {
+            try
+            {
+                while (true)
+                {
+                    size_t chunk_no;
+
+                    {
+                        unique_lock<mutex> lock(chunks_mutex);
+
+                        chunks_cv.wait(lock, [&] {
+                            return failed
+                                   || next_to_claim >= no_of_chunks
+                                   || next_to_claim < next_to_report
+                                                      + m_max_chunks_ahead;
+                        });
+
+                        if (failed || next_to_claim >= no_of_chunks)
+                        {
+                            return;
+                        }
+
+                        chunk_no = next_to_claim++;
+                    }
+
+                    scanned_chunk chunk;
+
+                    if (!scan_chunk(chunk_no, chunk))
+                    {
+                        fail(nullptr);
+                        return;
+                    }
+
+                    {
+                        lock_guard<mutex> lock(chunks_mutex);
+                        done_chunks[chunk_no] = std::move(chunk);
+                    }
+
+                    chunks_cv.notify_all();
+                }
+            }
+            catch (...)
+            {
+                // otherwise the chunk is never done, and
+                // the reporting loop below waits for it forever
+                fail(current_exception());
+            }
+        };
+
+        ThreadPool pool {m_no_of_threads};
+
+        vector<future<void>> workers;
+
+        for (size_t i = 0; i < pool.size(); ++i)
+        {
+            workers.push_back(pool.submit(worker));
+        }
+
+        // report chunks in order, as they become ready
+        try
+        {
+            while (true)
+            {
+                scanned_chunk chunk;
+
+                {
+                    unique_lock<mutex> lock(chunks_mutex);
+
+                    chunks_cv.wait(lock, [&] {
+                        return failed
+                               || next_to_report >= no_of_chunks
+                               || done_chunks.count(next_to_report) > 0;
+                    });
+
+                    if (failed || next_to_report >= no_of_chunks)
+                    {
+                        break;
+                    }
+
+                    auto it = done_chunks.find(next_to_report);
+
+                    chunk = std::move(it->second);
+                    done_chunks.erase(it);
+                }
+
+                for (const transfer_details& td: chunk.outputs)
+                {
+                    on_output(td);
+                }
+
+                summary.no_of_blocks += chunk.summary.no_of_blocks;
+                summary.no_of_txs += chunk.summary.no_of_txs;
+                summary.no_of_outputs += chunk.summary.no_of_outputs;
+
+                {
+                    lock_guard<mutex> lock(chunks_mutex);
+                    ++next_to_report;
+                }
+
+                // let workers claim further chunks
+                chunks_cv.notify_all();
+            }
+        }
+        catch (...)
+        {
+            // stop workers waiting for chunks to be reported
+            fail(current_exception());
+        }
+
+        for (future<void>& w: workers)
+        {
+            w.get();
+        }
+
+        if (error)
+        {
+            rethrow_exception(error);
+        }
+
+        summary.seconds = chrono::duration<double>(
+                chrono::steady_clock::now() - start).count();
+
+        return !failed;
+    }
+
+}
@@ -0,0 +1,77 @@
+#ifndef XMREG01_PARALLELOUTPUTSCANNER_H
+#define XMREG01_PARALLELOUTPUTSCANNER_H
+
+#include "MicroCore.h"
+#include "tx_details.h"
+#include "ThreadPool.h"
+
+#include <functional>
+
+
+namespace xmreg
+{
+    using namespace cryptonote;
+    using namespace crypto;
+    using namespace std;
+
+
+    struct output_scan_summary
+    {
+        uint64_t no_of_blocks {0};
+        uint64_t no_of_txs {0};
+        uint64_t no_of_outputs {0};
+        double seconds {0};
+    };
+
+
+    /**
+     * Finds outputs belonging to an account, given its
+     * private view key and public spend key, in a range of blocks,
+     * using many threads.
+     *
+     * Each block is scanned with the block level
+     * get_belonging_outputs. The height range is split into chunks
+     * of blocks. Idle workers take the next not yet scanned chunk,
+     * so faster workers simply scan more chunks. Results of chunks are passed to the
+     * callback in height order, in the calling thread, as soon as
+     * all earlier chunks are done.
+     *
+     * Workers never get more than max_chunks_ahead chunks ahead
+     * of the oldest chunk not yet passed to the callback, so memory
+     * use is bounded regardless of the range size.
+     *
+     * An exception thrown in a worker or in the callback stops
+     * the scan, and is rethrown by scan() once all workers are done.
+     */
+    class ParallelOutputScanner {
+
+        MicroCore& m_mcore;
+
+        secret_key m_private_view_key;
+        public_key m_public_spend_key;
+
+        size_t m_no_of_threads;
+        uint64_t m_chunk_size;
+        size_t m_max_chunks_ahead;
+
+    public:
+
+        using output_callback = function<void(const transfer_details&)>;
+
+        ParallelOutputScanner(MicroCore& mcore,
+                              const secret_key& private_view_key,
+                              const public_key& public_spend_key,
+                              size_t no_of_threads = 0,
+                              uint64_t chunk_size = 100,
+                              size_t max_chunks_ahead = 0);
+
+        bool
+        scan(uint64_t start_height,
+             uint64_t end_height,
+             const output_callback& on_output,
+             output_scan_summary& summary);
+    };
+
+}
+
+#endif //XMREG01_PARALLELOUTPUTSCANNER_H
@@ -0,0 +1,301 @@
+#include "PointCache.h"
+
+#include <algorithm>
+
+
+namespace xmreg
+{
+
+    namespace
+    {
+        /**
+         * Same as hash_to_ec in monero's crypto.cpp:
+         * Hp(P) = 8 * point_from_hash(H(P))
+         */
+        void
+        hash_to_ec(const public_key& key, ge_p3& res)
+        {
+            crypto::hash h;
+            ge_p2 point;
+            ge_p1p1 point2;
+
+            cn_fast_hash(&key, sizeof(public_key), h);
+
+            ge_fromfe_frombytes_vartime(
+                    &point, reinterpret_cast<const unsigned char*>(&h));
+
+            ge_mul8(&point2, &point);
+            ge_p1p1_to_p3(&res, &point2);
+        }
+
+        void
+        hash_to_scalar(const void* data, size_t size, ec_scalar& res)
+        {
+            crypto::hash h;
+
+            cn_fast_hash(data, size, h);
+
+            memcpy(&res, &h, sizeof(res));
+
+            sc_reduce32(reinterpret_cast<unsigned char*>(&res));
+        }
+
+        const unsigned char*
+        as_bytes(const ec_scalar& s)
+        {
+            return reinterpret_cast<const unsigned char*>(&s);
+        }
+
+        unsigned char*
+        as_bytes(ec_scalar& s)
+        {
+            return reinterpret_cast<unsigned char*>(&s);
+        }
+    }
+
+
+    PointCache::PointCache(size_t max_bytes):
+            m_cache(max_bytes)
+    {}
+
+
+    /**
+     * Get points of a ring member, from the cache if possible.
+     *
+     * Returns false if pub_key is not a valid point.
+     */
+    bool
+    PointCache::get(const public_key& pub_key, ring_member_points& points)
+    {
+        if (m_cache.get(pub_key, points))
+        {
+            return true;
+        }
+
+        if (!compute_points(pub_key, points))
+        {
+            return false;
+        }
+
+        m_cache.put(pub_key, points, ENTRY_SIZE);
+
+        return true;
+    }
+
+
+    bool
+    PointCache::compute_points(const public_key& pub_key,
+                               ring_member_points& points)
+    {
+        if (ge_frombytes_vartime(&points.pub_key,
+                                 reinterpret_cast<const unsigned char*>(&pub_key)) != 0)
+        {
+            return false;
+        }
+
+        hash_to_ec(pub_key, points.key_hash);
+
+        return true;
+    }
+
+
+    /**
+     * Check ring signature as crypto::check_ring_signature does,
+     * i.e., for each member i compute
+     *
+     *   a_i = c_i * P_i + r_i * G
+     *   b_i = r_i * Hp(P_i) + c_i * I
+     *
+     * and the signature is valid if
+     * H(prefix_hash, a_0, b_0, ...) == sum of c_i
+     */
+    bool
+    PointCache::check_ring_signature(const crypto::hash& prefix_hash,
+                                     const key_image& image,
+                                     const public_key* pub_keys,
+                                     size_t ring_size,
+                                     const signature* signatures)
+    {
+        ge_p3 image_unp;
+        ge_dsmp image_pre;
+
+        if (ge_frombytes_vartime(&image_unp,
+                                 reinterpret_cast<const unsigned char*>(&image)) != 0)
+        {
+            return false;
+        }
+
+        ge_dsm_precomp(image_pre, &image_unp);
+
+        // prefix hash followed by a_i, b_i of each member
+        vector<unsigned char> buf(sizeof(crypto::hash)
+                                  + 2 * sizeof(ec_point) * ring_size);
+
+        memcpy(buf.data(), &prefix_hash, sizeof(crypto::hash));
+
+        unsigned char* ab = buf.data() + sizeof(crypto::hash);
+
+        ec_scalar sum;
+        sc_0(as_bytes(sum));
+
+        ring_member_points points;
+
+        for (size_t i = 0; i < ring_size; ++i)
+        {
+            const signature& sig = signatures[i];
+
+            if (sc_check(as_bytes(sig.c)) != 0 || sc_check(as_bytes(sig.r)) != 0)
+            {
+                return false;
+            }
+
+            if (!get(pub_keys[i], points))
+            {
+                return false;
+            }
+
+            ge_p2 tmp2;
+
+            ge_double_scalarmult_base_vartime(&tmp2, as_bytes(sig.c),
+                                              &points.pub_key, as_bytes(sig.r));
+            ge_tobytes(ab, &tmp2);
+            ab += sizeof(ec_point);
+
+            ge_double_scalarmult_precomp_vartime(&tmp2, as_bytes(sig.r),
+                                                 &points.key_hash,
+                                                 as_bytes(sig.c), image_pre);
+            ge_tobytes(ab, &tmp2);
+            ab += sizeof(ec_point);
+
+            sc_add(as_bytes(sum), as_bytes(sum), as_bytes(sig.c));
+        }
+
+        ec_scalar h;
+
+        hash_to_scalar(buf.data(), buf.size(), h);
+
+        sc_sub(as_bytes(h), as_bytes(h), as_bytes(sum));
+
+        return sc_isnonzero(as_bytes(h)) == 0;
+    }
+
+
+    /**
+     * Sign a random ring, and check that check_ring_signature gives
+     * the same result as crypto::check_ring_signature for it, and
+     * for its copies with tampered c, r, key image and ring member.
+     *
+     * The valid ring is checked twice, so that the second check
+     * uses the cached points.
+     */
+    bool
+    PointCache::agrees_with_crypto(size_t ring_size)
+    {
+        ring_size = std::max<size_t>(ring_size, 1);
+
+        vector<public_key> pub_keys(ring_size);
+        vector<signature> signatures(ring_size);
+
+        size_t real_index = ring_size / 2;
+
+        secret_key sec;
+        secret_key real_sec;
+
+        for (size_t i = 0; i < ring_size; ++i)
+        {
+            generate_keys(pub_keys[i], sec);
+
+            if (i == real_index)
+            {
+                real_sec = sec;
+            }
+        }
+
+        vector<const public_key*> pub_key_ptrs;
+
+        for (const public_key& pub_key: pub_keys)
+        {
+            pub_key_ptrs.push_back(&pub_key);
+        }
+
+        crypto::hash prefix_hash;
+
+        cn_fast_hash(pub_keys.data(), pub_keys.size() * sizeof(public_key),
+                     prefix_hash);
+
+        key_image image;
+
+        generate_key_image(pub_keys[real_index], real_sec, image);
+
+        generate_ring_signature(prefix_hash, image, pub_key_ptrs,
+                                real_sec, real_index, signatures.data());
+
+        PointCache point_cache {2 * ring_size * ENTRY_SIZE};
+
+        auto agrees = [&](const key_image& k_image,
+                          const vector<public_key>& keys,
+                          const vector<signature>& sigs,
+                          bool expected)
+        {
+            vector<const public_key*> key_ptrs;
+
+            for (const public_key& key: keys)
+            {
+                key_ptrs.push_back(&key);
+            }
+
+            bool cached = point_cache.check_ring_signature(
+                    prefix_hash, k_image, keys.data(), keys.size(), sigs.data());
+
+            bool consensus = crypto::check_ring_signature(
+                    prefix_hash, k_image, key_ptrs, sigs.data());
+
+            return cached == consensus && consensus == expected;
+        };
+
+        if (!agrees(image, pub_keys, signatures, true)
+            || !agrees(image, pub_keys, signatures, true))
+        {
+            return false;
+        }
+
+        vector<signature> tampered_c = signatures;
+        as_bytes(tampered_c[0].c)[0] ^= 1;
+
+        vector<signature> tampered_r = signatures;
+        as_bytes(tampered_r[0].r)[0] ^= 1;
+
+        // key image and member of other, random keys
+        public_key other_pub_key;
+        secret_key other_sec;
+
+        generate_keys(other_pub_key, other_sec);
+
+        key_image other_image;
+
+        generate_key_image(other_pub_key, other_sec, other_image);
+
+        vector<public_key> tampered_keys = pub_keys;
+        tampered_keys[0] = other_pub_key;
+
+        return agrees(image, pub_keys, tampered_c, false)
+               && agrees(image, pub_keys, tampered_r, false)
+               && agrees(other_image, pub_keys, signatures, false)
+               && agrees(image, tampered_keys, signatures, false);
+    }
+
+
+    void
+    PointCache::set_max_bytes(size_t max_bytes)
+    {
+        m_cache.set_max_cost(max_bytes);
+    }
+
+
+    const PointCache::cache_t&
+    PointCache::get_cache() const
+    {
+        return m_cache;
+    }
+
+}
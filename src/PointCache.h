@@ -0,0 +1,92 @@
+#ifndef XMREG01_POINTCACHE_H
+#define XMREG01_POINTCACHE_H
+
+#include "monero_headers.h"
+#include "LruCache.h"
+
+extern "C" {
+#include "crypto/crypto-ops.h"
+}
+
+
+namespace xmreg
+{
+    using namespace cryptonote;
+    using namespace crypto;
+    using namespace std;
+
+
+    /**
+     * Group elements of a ring member needed to check
+     * a ring signature: its decompressed public key P
+     * and Hp(P), i.e., P hashed to a point.
+     */
+    struct ring_member_points
+    {
+        ge_p3 pub_key;
+        ge_p3 key_hash;
+    };
+
+
+    /**
+     * Cache of decompressed ring member points, keyed by
+     * output public key.
+     *
+     * Popular outputs are used as mixins in many rings, and
+     * decompressing a key and hashing it to a point are a large
+     * part of checking each ring member. check_ring_signature
+     * does the same as crypto::check_ring_signature, but takes
+     * the points from the cache.
+     *
+     * Memory is limited to max_bytes (0 disables the cache, in
+     * which case points are computed on each check). Thread safe.
+     *
+     * As check_ring_signature is a copy of the consensus check,
+     * agrees_with_crypto should be used to compare the two
+     * before relying on it.
+     */
+    class PointCache {
+
+    public:
+
+        using cache_t = LruCache<public_key, ring_member_points>;
+
+        // approximate memory of one entry, including
+        // list node and hash map overhead
+        static constexpr size_t ENTRY_SIZE {sizeof(ring_member_points)
+                                            + sizeof(public_key) + 64};
+
+    private:
+
+        cache_t m_cache;
+
+    public:
+
+        explicit PointCache(size_t max_bytes = 0);
+
+        bool
+        get(const public_key& pub_key, ring_member_points& points);
+
+        bool
+        check_ring_signature(const crypto::hash& prefix_hash,
+                             const key_image& image,
+                             const public_key* pub_keys,
+                             size_t ring_size,
+                             const signature* signatures);
+
+        void
+        set_max_bytes(size_t max_bytes);
+
+        const cache_t&
+        get_cache() const;
+
+        static bool
+        compute_points(const public_key& pub_key, ring_member_points& points);
+
+        static bool
+        agrees_with_crypto(size_t ring_size);
+    };
+
+}
+
+#endif //XMREG01_POINTCACHE_H
@@ -0,0 +1,244 @@
+#include "RangeScanner.h"
+#include "StageStats.h"
+
+#include <chrono>
+#include <thread>
+#include <atomic>
+
+
+namespace xmreg
+{
+
+    namespace
+    {
+        struct scanned_tx
+        {
+            crypto::hash tx_hash;
+            crypto::hash tx_prefix_hash;
+            size_t no_of_inputs {0};
+            vector<ring_data> rings;
+            vector<future<bool>> checks;
+        };
+
+        /**
+         * Block read ahead by the I/O thread
+         */
+        struct scanned_block
+        {
+            uint64_t height {0};
+            vector<scanned_tx> txs;
+        };
+    }
+
+
+    RangeScanner::RangeScanner(MicroCore& mcore,
+                               RingVerifier& verifier,
+                               size_t queue_size):
+            m_mcore(mcore), m_verifier(verifier),
+            m_queue_size(queue_size > 0 ? queue_size : 1)
+    {}
+
+
+    /**
+     * Verify all rings in blocks from start_height
+     * to end_height, inclusive.
+     *
+     * end_height is limited to the top block. on_invalid is
+     * called for every input with invalid ring signature.
+     */
+    bool
+    RangeScanner::scan(uint64_t start_height,
+                       uint64_t end_height,
+                       range_scan_summary& summary,
+                       const invalid_callback& on_invalid,
+                       bool show_progress)
+    {
+        summary = range_scan_summary {};
+
+        uint64_t blockchain_height = m_mcore.get_db().height();
+
+        if (blockchain_height == 0 || start_height >= blockchain_height)
+        {
+            cerr << "Start height " << start_height
+                 << " is above blockchain height "
+                 << blockchain_height << endl;
+            return false;
+        }
+
+        end_height = std::min(end_height, blockchain_height - 1);
+
+        auto start = chrono::steady_clock::now();
+
+        BoundedQueue<shared_ptr<scanned_block>> block_queue {m_queue_size};
+
+        atomic<bool> read_ok {true};
+
+        // I/O thread: read blocks, txs and rings ahead
+        thread reader([&]
+        {
+            for (uint64_t h = start_height; h <= end_height; ++h)
+            {
+                auto sblk = make_shared<scanned_block>();
+
+                sblk->height = h;
+
+                block blk;
+                vector<shared_ptr<const transaction>> txs;
+
+                if (!m_mcore.get_block_by_height(h, blk)
+                    || !m_mcore.get_block_txs(blk, txs, false))
+                {
+                    read_ok = false;
+                    break;
+                }
+
+                // skip coinbase tx, i.e., the first one
+                auto tx_it = txs.begin();
+
+                if (tx_it != txs.end())
+                {
+                    ++tx_it;
+                }
+
+                auto tx_hash_it = blk.tx_hashes.begin();
+
+                vector<const transaction*> block_txs;
+
+                for (; tx_it != txs.end(); ++tx_it, ++tx_hash_it)
+                {
+                    sblk->txs.emplace_back();
+
+                    scanned_tx& stx = sblk->txs.back();
+
+                    stx.tx_hash = *tx_hash_it;
+                    stx.tx_prefix_hash = get_transaction_prefix_hash(**tx_it);
+                    stx.no_of_inputs = (*tx_it)->vin.size();
+
+                    block_txs.push_back(tx_it->get());
+                }
+
+                // ring members of the whole block are read together
+                vector<vector<ring_data>> rings_of_txs;
+
+                if (!m_verifier.get_rings(block_txs, rings_of_txs))
+                {
+                    read_ok = false;
+                    break;
+                }
+
+                for (size_t i = 0; i < rings_of_txs.size(); ++i)
+                {
+                    sblk->txs[i].rings = std::move(rings_of_txs[i]);
+                }
+
+                if (!block_queue.push(sblk))
+                {
+                    break;
+                }
+            }
+
+            block_queue.close();
+        });
+
+        // verify blocks in order, keeping at most
+        // m_queue_size blocks in the pool
+        deque<shared_ptr<scanned_block>> in_flight;
+
+        auto collect_oldest = [&]
+        {
+            shared_ptr<scanned_block> sblk = in_flight.front();
+            in_flight.pop_front();
+
+            for (scanned_tx& stx: sblk->txs)
+            {
+                vector<uint64_t> results;
+
+                RingVerifier::collect_results(stx.rings, stx.checks,
+                                              stx.no_of_inputs, results);
+
+                for (const ring_data& ring: stx.rings)
+                {
+                    summary.no_of_signatures += ring.signatures.size();
+
+                    if (m_on_ring)
+                    {
+                        m_on_ring(sblk->height, stx.tx_hash, ring,
+                                  results[ring.input_index] == 1);
+                    }
+
+                    if (results[ring.input_index] != 1)
+                    {
+                        ++summary.no_of_invalid;
+
+                        if (on_invalid)
+                        {
+                            on_invalid(sblk->height, stx.tx_hash,
+                                       ring.input_index);
+                        }
+                    }
+                }
+
+                ++summary.no_of_txs;
+                summary.no_of_rings += stx.rings.size();
+            }
+
+            ++summary.no_of_blocks;
+
+            if (show_progress && summary.no_of_blocks % 1000 == 0)
+            {
+                cout << " - scanned blocks up to: " << sblk->height
+                     << "/" << end_height << "\r" << flush;
+            }
+        };
+
+        static StageGauge& queue_depth = StageStats::gauge("range_scan_queue_depth");
+        static StageGauge& in_flight_blocks = StageStats::gauge("range_scan_in_flight_blocks");
+
+        shared_ptr<scanned_block> sblk;
+
+        while (block_queue.pop(sblk))
+        {
+            set_gauge(queue_depth, block_queue.size());
+
+            for (scanned_tx& stx: sblk->txs)
+            {
+                stx.checks = m_verifier.submit_rings(stx.tx_prefix_hash,
+                                                     stx.rings);
+            }
+
+            in_flight.push_back(sblk);
+
+            if (in_flight.size() >= m_queue_size)
+            {
+                collect_oldest();
+            }
+
+            set_gauge(in_flight_blocks, in_flight.size());
+        }
+
+        while (!in_flight.empty())
+        {
+            collect_oldest();
+        }
+
+        reader.join();
+
+        if (show_progress)
+        {
+            cout << endl;
+        }
+
+        summary.seconds = chrono::duration<double>(
+                chrono::steady_clock::now() - start).count();
+
+        return read_ok;
+    }
+
+
+    void
+    RangeScanner::set_ring_callback(const ring_callback& on_ring)
+    {
+        m_on_ring = on_ring;
+    }
+
+}
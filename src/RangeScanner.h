@@ -0,0 +1,79 @@
+#ifndef XMREG01_RANGESCANNER_H
+#define XMREG01_RANGESCANNER_H
+
+#include "MicroCore.h"
+#include "RingVerifier.h"
+#include "BoundedQueue.h"
+
+#include <functional>
+
+
+namespace xmreg
+{
+    using namespace cryptonote;
+    using namespace crypto;
+    using namespace std;
+
+
+    struct range_scan_summary
+    {
+        uint64_t no_of_blocks {0};
+        uint64_t no_of_txs {0};
+        uint64_t no_of_rings {0};
+        uint64_t no_of_signatures {0};
+        uint64_t no_of_invalid {0};
+        double seconds {0};
+    };
+
+
+    /**
+     * Verifies ring signatures of all inputs of all non-coinbase
+     * transactions in a range of blocks.
+     *
+     * An I/O thread reads blocks, their transactions and
+     * ring members ahead, while the calling thread queues
+     * ring checks in RingVerifier's pool and collects the
+     * results, block by block in height order. This way the
+     * database and the cpus are busy at the same time.
+     */
+    class RangeScanner {
+
+        MicroCore& m_mcore;
+        RingVerifier& m_verifier;
+
+        size_t m_queue_size;
+
+    public:
+
+        using invalid_callback = function<void(uint64_t block_height,
+                                               const crypto::hash& tx_hash,
+                                               size_t input_index)>;
+
+        using ring_callback = function<void(uint64_t block_height,
+                                            const crypto::hash& tx_hash,
+                                            const ring_data& ring,
+                                            bool valid)>;
+
+        RangeScanner(MicroCore& mcore,
+                     RingVerifier& verifier,
+                     size_t queue_size = 64);
+
+        bool
+        scan(uint64_t start_height,
+             uint64_t end_height,
+             range_scan_summary& summary,
+             const invalid_callback& on_invalid = invalid_callback {},
+             bool show_progress = true);
+
+        // called for every verified ring, in height order
+        void
+        set_ring_callback(const ring_callback& on_ring);
+
+    private:
+
+        ring_callback m_on_ring;
+    };
+
+}
+
+#endif //XMREG01_RANGESCANNER_H
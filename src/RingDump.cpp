@@ -0,0 +1,497 @@
+#include "RingDump.h"
+
+#include <cstring>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+
+namespace xmreg
+{
+
+    namespace
+    {
+        constexpr uint64_t SECTION_ALIGNMENT {8};
+
+        uint64_t
+        align_up(uint64_t offset)
+        {
+            return (offset + SECTION_ALIGNMENT - 1)
+                   & ~(SECTION_ALIGNMENT - 1);
+        }
+
+        bool
+        write_padding(FILE* out, uint64_t& offset)
+        {
+            static const char zeros[SECTION_ALIGNMENT] {};
+
+            uint64_t padding = align_up(offset) - offset;
+
+            if (padding > 0 && fwrite(zeros, 1, padding, out) != padding)
+            {
+                return false;
+            }
+
+            offset += padding;
+
+            return true;
+        }
+
+        bool
+        write_bytes(FILE* out, const void* data, size_t size, uint64_t& offset)
+        {
+            if (size > 0 && fwrite(data, 1, size, out) != size)
+            {
+                return false;
+            }
+
+            offset += size;
+
+            return true;
+        }
+
+        /**
+         * Append content of a temporary column file to out
+         */
+        bool
+        append_file(FILE* out, FILE* in, uint64_t& offset)
+        {
+            if (fflush(in) != 0 || fseek(in, 0, SEEK_SET) != 0)
+            {
+                return false;
+            }
+
+            vector<char> buffer(1 << 20);
+
+            size_t read_bytes;
+
+            while ((read_bytes = fread(buffer.data(), 1, buffer.size(), in)) > 0)
+            {
+                if (!write_bytes(out, buffer.data(), read_bytes, offset))
+                {
+                    return false;
+                }
+            }
+
+            return !ferror(in);
+        }
+    }
+
+
+    const char RingDumpWriter::MAGIC[8] {'X', 'M', 'R', 'R', 'I', 'N', 'G', 'S'};
+
+
+    RingDumpWriter::RingDumpWriter(const string& path):
+            m_path(path)
+    {
+        m_member_start.push_back(0);
+
+        m_ok = true;
+
+        for (size_t col = 0; col < NO_OF_COLUMNS; ++col)
+        {
+            m_columns[col] = fopen(column_path(col).c_str(), "w+b");
+
+            if (!m_columns[col])
+            {
+                cerr << "Cant open " << column_path(col)
+                     << " for writing" << endl;
+                m_ok = false;
+            }
+        }
+
+        if (!m_ok)
+        {
+            remove_columns();
+        }
+    }
+
+
+    bool
+    RingDumpWriter::is_open() const
+    {
+        return m_ok;
+    }
+
+
+    bool
+    RingDumpWriter::add_ring(const crypto::hash& tx_hash,
+                             uint32_t input_index,
+                             const key_image& k_image,
+                             const vector<public_key>& members,
+                             const vector<signature>& signatures,
+                             bool valid)
+    {
+        if (!m_ok)
+        {
+            return false;
+        }
+
+        if (members.size() != signatures.size())
+        {
+            cerr << "Number of ring members and signatures differ for tx: "
+                 << tx_hash << endl;
+            return false;
+        }
+
+        uint64_t ignored {0};
+
+        m_ok = write_bytes(m_columns[TX_HASHES], &tx_hash,
+                           sizeof(tx_hash), ignored)
+            && write_bytes(m_columns[INPUT_IDX], &input_index,
+                           sizeof(input_index), ignored)
+            && write_bytes(m_columns[KEY_IMAGES], &k_image,
+                           sizeof(k_image), ignored)
+            && write_bytes(m_columns[MEMBERS], members.data(),
+                           members.size() * sizeof(public_key), ignored)
+            && write_bytes(m_columns[SIGNATURES], signatures.data(),
+                           signatures.size() * sizeof(signature), ignored);
+
+        if (!m_ok)
+        {
+            cerr << "Cant write ring data to " << m_path << endl;
+            return false;
+        }
+
+        if (m_no_of_rings % 8 == 0)
+        {
+            m_results.push_back(0);
+        }
+
+        if (valid)
+        {
+            m_results.back() |= static_cast<uint8_t>(1u << (m_no_of_rings % 8));
+        }
+
+        m_no_of_members += members.size();
+        m_member_start.push_back(m_no_of_members);
+
+        ++m_no_of_rings;
+
+        return true;
+    }
+
+
+    /**
+     * Write the final file and remove temporary column files
+     */
+    bool
+    RingDumpWriter::close()
+    {
+        if (!m_ok)
+        {
+            remove_columns();
+            return false;
+        }
+
+        FILE* out = fopen(m_path.c_str(), "wb");
+
+        if (!out)
+        {
+            cerr << "Cant open " << m_path << " for writing" << endl;
+            remove_columns();
+            m_ok = false;
+            return false;
+        }
+
+        ring_dump_header header;
+
+        memset(&header, 0, sizeof(header));
+        memcpy(header.magic, MAGIC, sizeof(header.magic));
+
+        header.version       = VERSION;
+        header.no_of_rings   = m_no_of_rings;
+        header.no_of_members = m_no_of_members;
+
+        // header is written twice: first as a placeholder,
+        // then with section offsets filled in
+        uint64_t offset {0};
+
+        bool ok = write_bytes(out, &header, sizeof(header), offset);
+
+        ok = ok && write_padding(out, offset);
+        header.tx_hashes_offset = offset;
+        ok = ok && append_file(out, m_columns[TX_HASHES], offset);
+
+        ok = ok && write_padding(out, offset);
+        header.input_idx_offset = offset;
+        ok = ok && append_file(out, m_columns[INPUT_IDX], offset);
+
+        ok = ok && write_padding(out, offset);
+        header.key_images_offset = offset;
+        ok = ok && append_file(out, m_columns[KEY_IMAGES], offset);
+
+        ok = ok && write_padding(out, offset);
+        header.member_start_offset = offset;
+        ok = ok && write_bytes(out, m_member_start.data(),
+                               m_member_start.size() * sizeof(uint64_t),
+                               offset);
+
+        ok = ok && write_padding(out, offset);
+        header.members_offset = offset;
+        ok = ok && append_file(out, m_columns[MEMBERS], offset);
+
+        ok = ok && write_padding(out, offset);
+        header.signatures_offset = offset;
+        ok = ok && append_file(out, m_columns[SIGNATURES], offset);
+
+        ok = ok && write_padding(out, offset);
+        header.results_offset = offset;
+        ok = ok && write_bytes(out, m_results.data(), m_results.size(), offset);
+
+        header.file_size = offset;
+
+        uint64_t ignored {0};
+
+        ok = ok && fseek(out, 0, SEEK_SET) == 0
+                && write_bytes(out, &header, sizeof(header), ignored);
+
+        ok = (fclose(out) == 0) && ok;
+
+        if (!ok)
+        {
+            cerr << "Cant write " << m_path << endl;
+        }
+
+        remove_columns();
+
+        m_ok = false;
+
+        return ok;
+    }
+
+
+    uint64_t
+    RingDumpWriter::no_of_rings() const
+    {
+        return m_no_of_rings;
+    }
+
+
+    string
+    RingDumpWriter::column_path(size_t col) const
+    {
+        return m_path + ".col" + to_string(col) + ".tmp";
+    }
+
+
+    void
+    RingDumpWriter::remove_columns()
+    {
+        for (size_t col = 0; col < NO_OF_COLUMNS; ++col)
+        {
+            if (m_columns[col])
+            {
+                fclose(m_columns[col]);
+                m_columns[col] = nullptr;
+                remove(column_path(col).c_str());
+            }
+        }
+    }
+
+
+    RingDumpWriter::~RingDumpWriter()
+    {
+        if (m_ok)
+        {
+            close();
+        }
+
+        remove_columns();
+    }
+
+
+
+    bool
+    RingDumpReader::open(const string& path)
+    {
+        close();
+
+        int fd = ::open(path.c_str(), O_RDONLY);
+
+        if (fd < 0)
+        {
+            cerr << "Cant open " << path << endl;
+            return false;
+        }
+
+        struct stat st;
+
+        if (fstat(fd, &st) != 0
+            || static_cast<size_t>(st.st_size) < sizeof(ring_dump_header))
+        {
+            cerr << "Not a ring dump file: " << path << endl;
+            ::close(fd);
+            return false;
+        }
+
+        void* data = mmap(nullptr, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+
+        // mapping stays valid after closing the descriptor
+        ::close(fd);
+
+        if (data == MAP_FAILED)
+        {
+            cerr << "Cant mmap " << path << endl;
+            return false;
+        }
+
+        m_data   = static_cast<const uint8_t*>(data);
+        m_size   = st.st_size;
+        m_header = reinterpret_cast<const ring_dump_header*>(m_data);
+
+        const ring_dump_header& h = *m_header;
+
+        // check that all sections are inside the file
+        auto section_fits = [&](uint64_t offset, uint64_t count, uint64_t size)
+        {
+            return offset % SECTION_ALIGNMENT == 0
+                   && offset <= m_size
+                   && count <= (m_size - offset) / size;
+        };
+
+        bool valid = memcmp(h.magic, RingDumpWriter::MAGIC, sizeof(h.magic)) == 0
+                && h.version == RingDumpWriter::VERSION
+                && h.file_size == m_size
+                && section_fits(h.tx_hashes_offset, h.no_of_rings,
+                                sizeof(crypto::hash))
+                && section_fits(h.input_idx_offset, h.no_of_rings,
+                                sizeof(uint32_t))
+                && section_fits(h.key_images_offset, h.no_of_rings,
+                                sizeof(key_image))
+                && section_fits(h.member_start_offset, h.no_of_rings + 1,
+                                sizeof(uint64_t))
+                && section_fits(h.members_offset, h.no_of_members,
+                                sizeof(public_key))
+                && section_fits(h.signatures_offset, h.no_of_members,
+                                sizeof(signature))
+                && section_fits(h.results_offset, (h.no_of_rings + 7) / 8, 1);
+
+        if (valid)
+        {
+            const uint64_t* member_start
+                    = section<uint64_t>(h.member_start_offset);
+
+            valid = member_start[0] == 0
+                    && member_start[h.no_of_rings] == h.no_of_members;
+
+            // ring sizes are computed from neighbouring starts, so
+            // these must not decrease for members to stay in range
+            for (uint64_t i = 0; valid && i < h.no_of_rings; ++i)
+            {
+                valid = member_start[i] <= member_start[i + 1];
+            }
+        }
+
+        if (!valid)
+        {
+            cerr << "Invalid or unsupported ring dump file: " << path << endl;
+            close();
+            return false;
+        }
+
+        return true;
+    }
+
+
+    void
+    RingDumpReader::close()
+    {
+        if (m_data)
+        {
+            munmap(const_cast<uint8_t*>(m_data), m_size);
+        }
+
+        m_data   = nullptr;
+        m_size   = 0;
+        m_header = nullptr;
+    }
+
+
+    bool
+    RingDumpReader::is_open() const
+    {
+        return m_data != nullptr;
+    }
+
+
+    uint64_t
+    RingDumpReader::no_of_rings() const
+    {
+        return m_header->no_of_rings;
+    }
+
+
+    uint64_t
+    RingDumpReader::no_of_members() const
+    {
+        return m_header->no_of_members;
+    }
+
+
+    const crypto::hash&
+    RingDumpReader::tx_hash(uint64_t ring_i) const
+    {
+        return section<crypto::hash>(m_header->tx_hashes_offset)[ring_i];
+    }
+
+
+    uint32_t
+    RingDumpReader::input_index(uint64_t ring_i) const
+    {
+        return section<uint32_t>(m_header->input_idx_offset)[ring_i];
+    }
+
+
+    const key_image&
+    RingDumpReader::get_key_image(uint64_t ring_i) const
+    {
+        return section<key_image>(m_header->key_images_offset)[ring_i];
+    }
+
+
+    uint64_t
+    RingDumpReader::ring_size(uint64_t ring_i) const
+    {
+        const uint64_t* member_start
+                = section<uint64_t>(m_header->member_start_offset);
+
+        return member_start[ring_i + 1] - member_start[ring_i];
+    }
+
+
+    const public_key*
+    RingDumpReader::members(uint64_t ring_i) const
+    {
+        uint64_t first = section<uint64_t>(m_header->member_start_offset)[ring_i];
+
+        return section<public_key>(m_header->members_offset) + first;
+    }
+
+
+    const signature*
+    RingDumpReader::signatures(uint64_t ring_i) const
+    {
+        uint64_t first = section<uint64_t>(m_header->member_start_offset)[ring_i];
+
+        return section<signature>(m_header->signatures_offset) + first;
+    }
+
+
+    bool
+    RingDumpReader::is_valid(uint64_t ring_i) const
+    {
+        const uint8_t* results = section<uint8_t>(m_header->results_offset);
+
+        return (results[ring_i / 8] >> (ring_i % 8)) & 1u;
+    }
+
+
+    RingDumpReader::~RingDumpReader()
+    {
+        close();
+    }
+
+}
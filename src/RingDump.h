@@ -0,0 +1,193 @@
+#ifndef XMREG01_RINGDUMP_H
+#define XMREG01_RINGDUMP_H
+
+#include "monero_headers.h"
+
+#include <cstdio>
+#include <string>
+#include <vector>
+
+
+namespace xmreg
+{
+    using namespace cryptonote;
+    using namespace crypto;
+    using namespace std;
+
+
+    /**
+     * Binary, columnar file with ring signature data.
+     *
+     * The file starts with ring_dump_header, followed by
+     * sections (columns), each starting at an 8 byte aligned offset
+     * given in the header:
+     *
+     *  - tx_hashes:    crypto::hash per ring
+     *  - input_idx:    uint32_t per ring, index of input in its tx
+     *  - key_images:   crypto::key_image per ring
+     *  - member_start: uint64_t per ring + 1, index of ring's first
+     *                  member in the next two sections, so ring i has
+     *                  member_start[i+1] - member_start[i] members
+     *  - members:      crypto::public_key per ring member
+     *  - signatures:   crypto::signature (c, r) per ring member
+     *  - results:      1 bit per ring, set if its signature is valid
+     *
+     * Integers are written in the byte order of the machine that
+     * wrote the file, so that it can be mmaped and used in place, see
+     * RingDumpReader. The reader rejects files of the other byte order,
+     * as their version field does not match.
+     */
+    struct ring_dump_header
+    {
+        char magic[8];
+        uint32_t version;
+        uint32_t reserved;
+
+        uint64_t no_of_rings;
+        uint64_t no_of_members;
+
+        uint64_t tx_hashes_offset;
+        uint64_t input_idx_offset;
+        uint64_t key_images_offset;
+        uint64_t member_start_offset;
+        uint64_t members_offset;
+        uint64_t signatures_offset;
+        uint64_t results_offset;
+
+        uint64_t file_size;
+    };
+
+
+    /**
+     * Writes ring dump files.
+     *
+     * The number of rings is not known in advance, so each
+     * column is first written to its own temporary file. close()
+     * writes the header and concatenates the columns into the
+     * final file.
+     */
+    class RingDumpWriter {
+
+        string m_path;
+
+        enum column {TX_HASHES, INPUT_IDX, KEY_IMAGES, MEMBERS, SIGNATURES,
+                     NO_OF_COLUMNS};
+
+        FILE* m_columns[NO_OF_COLUMNS] {};
+
+        vector<uint64_t> m_member_start;
+        vector<uint8_t> m_results;
+
+        uint64_t m_no_of_rings {0};
+        uint64_t m_no_of_members {0};
+
+        bool m_ok {false};
+
+    public:
+
+        static const char MAGIC[8];
+        static constexpr uint32_t VERSION {1};
+
+        explicit RingDumpWriter(const string& path);
+
+        RingDumpWriter(const RingDumpWriter&) = delete;
+        RingDumpWriter& operator=(const RingDumpWriter&) = delete;
+
+        bool
+        is_open() const;
+
+        bool
+        add_ring(const crypto::hash& tx_hash,
+                 uint32_t input_index,
+                 const key_image& k_image,
+                 const vector<public_key>& members,
+                 const vector<signature>& signatures,
+                 bool valid);
+
+        bool
+        close();
+
+        uint64_t
+        no_of_rings() const;
+
+        ~RingDumpWriter();
+
+    private:
+
+        string
+        column_path(size_t col) const;
+
+        void
+        remove_columns();
+    };
+
+
+    /**
+     * Read only, zero copy access to a ring dump file
+     * through mmap.
+     */
+    class RingDumpReader {
+
+        const uint8_t* m_data {nullptr};
+        size_t m_size {0};
+
+        const ring_dump_header* m_header {nullptr};
+
+    public:
+
+        RingDumpReader() = default;
+
+        RingDumpReader(const RingDumpReader&) = delete;
+        RingDumpReader& operator=(const RingDumpReader&) = delete;
+
+        bool
+        open(const string& path);
+
+        void
+        close();
+
+        bool
+        is_open() const;
+
+        uint64_t
+        no_of_rings() const;
+
+        uint64_t
+        no_of_members() const;
+
+        const crypto::hash&
+        tx_hash(uint64_t ring_i) const;
+
+        uint32_t
+        input_index(uint64_t ring_i) const;
+
+        const key_image&
+        get_key_image(uint64_t ring_i) const;
+
+        uint64_t
+        ring_size(uint64_t ring_i) const;
+
+        const public_key*
+        members(uint64_t ring_i) const;
+
+        const signature*
+        signatures(uint64_t ring_i) const;
+
+        bool
+        is_valid(uint64_t ring_i) const;
+
+        ~RingDumpReader();
+
+    private:
+
+        template<typename T>
+        const T*
+        section(uint64_t offset) const
+        {
+            return reinterpret_cast<const T*>(m_data + offset);
+        }
+    };
+
+}
+
+#endif //XMREG01_RINGDUMP_H
@@ -0,0 +1,474 @@
+#include "RingServer.h"
+#include "tools.h"
+
+#include <boost/regex.hpp>
+#include <boost/filesystem.hpp>
+
+#include <cerrno>
+#include <cstring>
+
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+
+namespace xmreg
+{
+
+    using boost::asio::local::stream_protocol;
+
+    namespace
+    {
+        // string fields of requests, compiled once
+        const boost::regex method_regex {
+                "\"method\"\\s*:\\s*\"([^\"\\\\]*)\""};
+
+        const boost::regex txhash_regex {
+                "\"txhash\"\\s*:\\s*\"([^\"\\\\]*)\""};
+
+
+        /**
+         * Get value of a string field from a flat json object.
+         *
+         * Requests are simple, one level objects with
+         * string values, so there is no need for a full
+         * json parser here.
+         */
+        bool
+        get_json_str(const string& json, const boost::regex& field_regex,
+                     string& value)
+        {
+            boost::smatch match;
+
+            if (!boost::regex_search(json, match, field_regex))
+            {
+                return false;
+            }
+
+            value = match[1];
+
+            return true;
+        }
+
+
+        string
+        json_escape(const string& in)
+        {
+            string out;
+            out.reserve(in.size());
+
+            for (char c: in)
+            {
+                switch (c)
+                {
+                    case '"':  out += "\\\""; break;
+                    case '\\': out += "\\\\"; break;
+                    case '\n': out += "\\n";  break;
+                    case '\r': out += "\\r";  break;
+                    case '\t': out += "\\t";  break;
+                    default:
+                        if (static_cast<unsigned char>(c) < 0x20)
+                        {
+                            continue;
+                        }
+                        out += c;
+                }
+            }
+
+            return out;
+        }
+
+
+        string
+        json_error(const string& message)
+        {
+            return "{\"status\":\"error\",\"error\":\""
+                   + json_escape(message) + "\"}";
+        }
+    }
+
+
+    constexpr size_t RingServer::MAX_REQUEST_LINE;
+
+
+    RingServer::RingServer(MicroCore& mcore,
+                           const string& socket_path,
+                           size_t no_of_threads,
+                           size_t point_cache_size,
+                           size_t max_connections):
+            m_mcore(mcore),
+            m_verifier(mcore, no_of_threads, point_cache_size),
+            m_socket_path(socket_path),
+            m_max_connections(max_connections > 0 ? max_connections : 1)
+    {}
+
+
+    /**
+     * Listen on the unix socket and serve requests.
+     *
+     * Returns only if the socket can't be created
+     * or accept fails, after all connections are closed.
+     */
+    bool
+    RingServer::run()
+    {
+        asio::io_service io_service;
+
+        if (!remove_stale_socket())
+        {
+            return false;
+        }
+
+        try
+        {
+            stream_protocol::acceptor acceptor(
+                    io_service, stream_protocol::endpoint(m_socket_path));
+
+            cout << "Listening on: " << m_socket_path << endl;
+
+            while (true)
+            {
+                {
+                    unique_lock<mutex> lock(m_connections_mutex);
+
+                    // join threads of closed connections, and
+                    // wait for one to close if at the limit
+                    while (true)
+                    {
+                        for (auto it = m_connections.begin();
+                             it != m_connections.end();)
+                        {
+                            if (it->done)
+                            {
+                                it->worker.join();
+                                it = m_connections.erase(it);
+                            }
+                            else
+                            {
+                                ++it;
+                            }
+                        }
+
+                        if (m_connections.size() < m_max_connections)
+                        {
+                            break;
+                        }
+
+                        m_connections_cv.wait(lock);
+                    }
+                }
+
+                auto socket = make_shared<stream_protocol::socket>(io_service);
+
+                acceptor.accept(*socket);
+
+                lock_guard<mutex> lock(m_connections_mutex);
+
+                m_connections.emplace_back();
+
+                auto conn = prev(m_connections.end());
+
+                conn->socket = socket;
+
+                // list iterators stay valid until the
+                // connection is erased, after join
+                conn->worker = thread([this, conn]
+                {
+                    handle_connection(conn->socket);
+
+                    {
+                        lock_guard<mutex> lock(m_connections_mutex);
+                        conn->done = true;
+                    }
+
+                    m_connections_cv.notify_all();
+                });
+            }
+        }
+        catch (const exception& e)
+        {
+            cerr << "Server error on " << m_socket_path
+                 << ": " << e.what() << endl;
+        }
+
+        close_connections();
+
+        return false;
+    }
+
+
+    /**
+     * Socket next to the blockchain folder, e.g.,
+     * ~/.bitmonero/rings.sock, rather than in a world
+     * writable directory such as /tmp
+     */
+    string
+    RingServer::get_default_socket_path(const string& blockchain_path)
+    {
+        boost::filesystem::path bc_path {blockchain_path};
+
+        return (bc_path.parent_path() / "rings.sock").string();
+    }
+
+
+    /**
+     * Remove socket file left by a previous run, otherwise
+     * bind fails. Anything else found at the socket path,
+     * including a symlink, is left alone.
+     */
+    bool
+    RingServer::remove_stale_socket() const
+    {
+        struct stat st;
+
+        if (::lstat(m_socket_path.c_str(), &st) != 0)
+        {
+            if (errno == ENOENT)
+            {
+                return true;
+            }
+
+            cerr << "Cant stat " << m_socket_path
+                 << ": " << strerror(errno) << endl;
+            return false;
+        }
+
+        if (!S_ISSOCK(st.st_mode))
+        {
+            cerr << m_socket_path << " exists and is not a socket" << endl;
+            return false;
+        }
+
+        if (::unlink(m_socket_path.c_str()) != 0)
+        {
+            cerr << "Cant remove old socket " << m_socket_path
+                 << ": " << strerror(errno) << endl;
+            return false;
+        }
+
+        return true;
+    }
+
+
+    /**
+     * Shut down sockets of all connections, so that
+     * their blocking reads return, and join their threads
+     */
+    void
+    RingServer::close_connections()
+    {
+        list<connection> connections;
+
+        {
+            lock_guard<mutex> lock(m_connections_mutex);
+
+            for (connection& conn: m_connections)
+            {
+                // native shutdown, as the socket object is
+                // being read from in the connection's thread
+                ::shutdown(conn.socket->native_handle(), SHUT_RDWR);
+            }
+
+            // iterators held by connection threads stay valid
+            connections.swap(m_connections);
+        }
+
+        for (connection& conn: connections)
+        {
+            conn.worker.join();
+        }
+    }
+
+
+    RingServer::~RingServer()
+    {
+        close_connections();
+    }
+
+
+    /**
+     * Read requests, one per line, until the client
+     * closes the connection.
+     */
+    void
+    RingServer::handle_connection(shared_ptr<stream_protocol::socket> socket)
+    {
+        // bounded, so that a client can't fill the memory
+        // with a line that never ends
+        asio::streambuf buffer(MAX_REQUEST_LINE);
+
+        try
+        {
+            while (true)
+            {
+                boost::system::error_code ec;
+
+                asio::read_until(*socket, buffer, '\n', ec);
+
+                if (ec == asio::error::not_found)
+                {
+                    string response = json_error("request line too long") + "\n";
+
+                    asio::write(*socket, asio::buffer(response), ec);
+                    break;
+                }
+
+                if (ec)
+                {
+                    // eof or broken connection
+                    break;
+                }
+
+                istream is(&buffer);
+
+                string request;
+                getline(is, request);
+
+                string response = handle_request(request) + "\n";
+
+                asio::write(*socket, asio::buffer(response));
+            }
+        }
+        catch (const exception& e)
+        {
+            cerr << "Connection error: " << e.what() << endl;
+        }
+    }
+
+
+    /**
+     * Process one request line and return
+     * one response line (without the new line).
+     */
+    string
+    RingServer::handle_request(const string& request)
+    {
+        string method;
+
+        if (!get_json_str(request, method_regex, method))
+        {
+            return json_error("no method given");
+        }
+
+        if (method == "ping")
+        {
+            return "{\"status\":\"ok\"}";
+        }
+
+        if (method != "verify" && method != "inspect")
+        {
+            return json_error("unknown method: " + method);
+        }
+
+        string tx_hash_str;
+
+        if (!get_json_str(request, txhash_regex, tx_hash_str))
+        {
+            return json_error("no txhash given");
+        }
+
+        crypto::hash tx_hash;
+
+        if (!parse_hash256(tx_hash_str, tx_hash))
+        {
+            return json_error("cant parse tx hash: " + tx_hash_str);
+        }
+
+        try
+        {
+            return verify(tx_hash, method == "inspect");
+        }
+        catch (const exception& e)
+        {
+            return json_error(e.what());
+        }
+    }
+
+
+    /**
+     * Verify all rings of the given tx.
+     *
+     * For inspect, public keys of ring members and
+     * the signatures are returned as well.
+     */
+    string
+    RingServer::verify(const crypto::hash& tx_hash, bool inspect)
+    {
+        shared_ptr<const transaction> tx;
+        vector<ring_data> rings;
+
+        {
+            lock_guard<mutex> lock(m_db_mutex);
+
+            if (!m_mcore.get_tx(tx_hash, tx))
+            {
+                return json_error("tx not found: "
+                                  + epee::string_tools::pod_to_hex(tx_hash));
+            }
+
+            if (!m_verifier.get_rings(*tx, rings))
+            {
+                return json_error("cant get rings of tx: "
+                                  + epee::string_tools::pod_to_hex(tx_hash));
+            }
+        }
+
+        vector<uint64_t> results;
+
+        if (!m_verifier.verify_rings(get_transaction_prefix_hash(*tx),
+                                     rings, tx->vin.size(), results))
+        {
+            return json_error("cant verify rings of tx: "
+                              + epee::string_tools::pod_to_hex(tx_hash));
+        }
+
+        bool all_valid = !rings.empty();
+
+        stringstream ss;
+
+        ss << "{\"status\":\"ok\","
+           << "\"txhash\":\"" << as_hex(tx_hash) << "\","
+           << "\"inputs\":[";
+
+        for (size_t i = 0; i < rings.size(); ++i)
+        {
+            const ring_data& ring = rings[i];
+
+            bool valid = results[ring.input_index] == 1;
+
+            all_valid = all_valid && valid;
+
+            ss << (i > 0 ? "," : "")
+               << "{\"index\":" << ring.input_index << ","
+               << "\"key_image\":\""
+               << as_hex(ring.k_image) << "\","
+               << "\"ring_size\":" << ring.pub_keys.size() << ","
+               << "\"valid\":" << (valid ? "true" : "false");
+
+            if (inspect)
+            {
+                ss << ",\"ring\":[";
+
+                for (size_t k = 0; k < ring.pub_keys.size(); ++k)
+                {
+                    ss << (k > 0 ? "," : "")
+                       << "{\"pubkey\":\""
+                       << as_hex(ring.pub_keys[k]) << "\","
+                       << "\"c\":\""
+                       << as_hex(ring.signatures[k].c) << "\","
+                       << "\"r\":\""
+                       << as_hex(ring.signatures[k].r) << "\"}";
+                }
+
+                ss << "]";
+            }
+
+            ss << "}";
+        }
+
+        ss << "],\"valid\":" << (all_valid ? "true" : "false") << "}";
+
+        return ss.str();
+    }
+
+}
@@ -0,0 +1,116 @@
+#ifndef XMREG01_RINGSERVER_H
+#define XMREG01_RINGSERVER_H
+
+#include "MicroCore.h"
+#include "RingVerifier.h"
+
+#include <boost/asio.hpp>
+
+#include <condition_variable>
+#include <list>
+#include <mutex>
+#include <string>
+#include <thread>
+
+
+namespace xmreg
+{
+    using namespace cryptonote;
+    using namespace crypto;
+    using namespace std;
+
+    namespace asio = boost::asio;
+
+
+    /**
+     * Serves verify/inspect requests over a unix domain socket.
+     *
+     * The blockchain is opened only once, by the MicroCore
+     * given, and stays open for the life time of the server.
+     *
+     * Protocol is line delimited json. Each request is one line:
+     *
+     *  {"method": "verify",  "txhash": "<hex>"}
+     *  {"method": "inspect", "txhash": "<hex>"}
+     *  {"method": "ping"}
+     *
+     * and each response is also one line, with "status"
+     * being "ok" or "error". Each connection is handled in its own
+     * thread and can send any number of requests. At most
+     * max_connections clients are served at once, others wait
+     * to be accepted until one of them disconnects. A client
+     * sending a line longer than MAX_REQUEST_LINE gets an error
+     * and is disconnected.
+     */
+    class RingServer {
+
+        struct connection
+        {
+            shared_ptr<asio::local::stream_protocol::socket> socket;
+            thread worker;
+            bool done {false};
+        };
+
+        // longest request line accepted, see handle_connection
+        static constexpr size_t MAX_REQUEST_LINE {4096};
+
+        MicroCore& m_mcore;
+        RingVerifier m_verifier;
+
+        string m_socket_path;
+
+        size_t m_max_connections;
+
+        // BlockchainLMDB is not meant to be used from many
+        // threads at once, so all database reads are serialized.
+        // Signature checks run in RingVerifier's pool.
+        mutex m_db_mutex;
+
+        // guarded by m_connections_mutex
+        list<connection> m_connections;
+
+        mutex m_connections_mutex;
+        condition_variable m_connections_cv;
+
+    public:
+
+        static constexpr size_t DEFAULT_MAX_CONNECTIONS {16};
+
+        RingServer(MicroCore& mcore,
+                   const string& socket_path,
+                   size_t no_of_threads = 0,
+                   size_t point_cache_size = 0,
+                   size_t max_connections = DEFAULT_MAX_CONNECTIONS);
+
+        RingServer(const RingServer&) = delete;
+        RingServer& operator=(const RingServer&) = delete;
+
+        bool
+        run();
+
+        string
+        handle_request(const string& request);
+
+        static string
+        get_default_socket_path(const string& blockchain_path);
+
+        ~RingServer();
+
+    private:
+
+        bool
+        remove_stale_socket() const;
+
+        void
+        close_connections();
+
+        void
+        handle_connection(shared_ptr<asio::local::stream_protocol::socket> socket);
+
+        string
+        verify(const crypto::hash& tx_hash, bool inspect);
+    };
+
+}
+
+#endif //XMREG01_RINGSERVER_H
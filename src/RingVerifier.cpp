@@ -0,0 +1,341 @@
+#include "RingVerifier.h"
+#include "StageStats.h"
+
+
+namespace xmreg
+{
+
+    namespace
+    {
+        // compared once per process, as it signs random rings
+        bool
+        point_cache_agrees_with_crypto()
+        {
+            static const bool agrees = PointCache::agrees_with_crypto(1)
+                                       && PointCache::agrees_with_crypto(5);
+            return agrees;
+        }
+    }
+
+
+    RingVerifier::RingVerifier(MicroCore& mcore,
+                               size_t no_of_threads,
+                               size_t point_cache_size):
+            m_mcore(mcore), m_pool(no_of_threads),
+            m_point_cache(point_cache_size),
+            m_point_cache_entries("point_cache_entries", [this]
+            {
+                return static_cast<double>(m_point_cache.get_cache().size());
+            }),
+            m_point_cache_hit_ratio("point_cache_hit_ratio", [this]
+            {
+                return m_point_cache.get_cache().hit_rate();
+            })
+    {
+        if (point_cache_size > 0 && !point_cache_agrees_with_crypto())
+        {
+            cerr << "PointCache::check_ring_signature disagrees with "
+                 << "crypto::check_ring_signature, point cache disabled" << endl;
+
+            m_point_cache.set_max_bytes(0);
+        }
+    }
+
+
+    /**
+     * Collect key images, ring members' public keys
+     * and signatures of all txin_to_key inputs of
+     * the given transaction.
+     *
+     * Inputs of other types (e.g., coinbase txin_gen)
+     * are skipped.
+     */
+    bool
+    RingVerifier::get_rings(const transaction& tx, vector<ring_data>& rings)
+    {
+        vector<vector<ring_data>> rings_of_txs;
+
+        if (!get_rings(vector<const transaction*> {&tx}, rings_of_txs))
+        {
+            return false;
+        }
+
+        rings = std::move(rings_of_txs.front());
+
+        return true;
+    }
+
+
+    /**
+     * Same as above, but for many txs, e.g., of a block.
+     *
+     * Ring members of all the txs are read from the
+     * blockchain together, so that outputs used in
+     * more than one ring are read only once.
+     */
+    bool
+    RingVerifier::get_rings(const vector<const transaction*>& txs,
+                            vector<vector<ring_data>>& rings_of_txs)
+    {
+        static StageTimer& timer = StageStats::timer("resolve_ring_members");
+
+        rings_of_txs.clear();
+        rings_of_txs.resize(txs.size());
+
+        OutputKeyResolver resolver {m_mcore.get_db()};
+
+        for (const transaction* tx: txs)
+        {
+            resolver.add_tx(*tx);
+        }
+
+        {
+            ScopedTimer scoped_timer {timer};
+
+            if (!resolver.resolve())
+            {
+                return false;
+            }
+        }
+
+        for (size_t i = 0; i < txs.size(); ++i)
+        {
+            if (!make_rings(*txs[i], resolver, rings_of_txs[i]))
+            {
+                return false;
+            }
+        }
+
+        return true;
+    }
+
+
+    bool
+    RingVerifier::make_rings(const transaction& tx,
+                             const OutputKeyResolver& resolver,
+                             vector<ring_data>& rings)
+    {
+        static StageCounter& ring_members = StageStats::counter("ring_members");
+
+        rings.clear();
+        rings.reserve(tx.vin.size());
+
+        vector<output_data_t> outputs;
+
+        for (size_t i = 0; i < tx.vin.size(); ++i)
+        {
+            const txin_v& tx_in = tx.vin[i];
+
+            if (tx_in.type() != typeid(txin_to_key))
+            {
+                continue;
+            }
+
+            const txin_to_key& tx_in_to_key = boost::get<txin_to_key>(tx_in);
+
+            if (i >= tx.signatures.size()
+                || tx.signatures[i].size() != tx_in_to_key.key_offsets.size())
+            {
+                cerr << "Number of signatures does not match "
+                     << "ring size of input no: " << i << endl;
+                return false;
+            }
+
+            // get public keys used in a given mixin
+            if (!resolver.get(tx_in_to_key.amount,
+                              relative_output_offsets_to_absolute(
+                                      tx_in_to_key.key_offsets),
+                              outputs))
+            {
+                cerr << "Cant get outputs of input no: " << i << endl;
+                return false;
+            }
+
+            rings.push_back(ring_data {i, tx_in_to_key.k_image, {},
+                                       tx.signatures[i]});
+
+            ring_data& ring = rings.back();
+
+            ring.pub_keys.reserve(outputs.size());
+
+            count_stage(ring_members, outputs.size());
+
+            for (const output_data_t& output_data: outputs)
+            {
+                ring.pub_keys.push_back(output_data.pubkey);
+            }
+        }
+
+        return true;
+    }
+
+
+    /**
+     * Verify ring signatures of all inputs of the given transaction.
+     *
+     * results[i] is set to 1 if the ring signature of i-th input
+     * is valid, and to 0 otherwise.
+     */
+    bool
+    RingVerifier::verify_tx(const transaction& tx, vector<uint64_t>& results)
+    {
+        vector<ring_data> rings;
+
+        if (!get_rings(tx, rings))
+        {
+            return false;
+        }
+
+        return verify_rings(get_transaction_prefix_hash(tx),
+                            rings, tx.vin.size(), results);
+    }
+
+
+    /**
+     * Check given rings using the worker pool.
+     *
+     * The results are stored in the input order, i.e.,
+     * results[ring.input_index] holds the result of the ring.
+     * Inputs without a ring are set to 0.
+     */
+    bool
+    RingVerifier::verify_rings(const crypto::hash& tx_prefix_hash,
+                               const vector<ring_data>& rings,
+                               size_t no_of_inputs,
+                               vector<uint64_t>& results)
+    {
+        vector<future<bool>> checks = submit_rings(tx_prefix_hash, rings);
+
+        return collect_results(rings, checks, no_of_inputs, results);
+    }
+
+
+    /**
+     * Queue checks of given rings in the worker pool,
+     * without waiting for them.
+     *
+     * tx_prefix_hash and rings must stay alive until
+     * all returned futures are ready.
+     */
+    vector<future<bool>>
+    RingVerifier::submit_rings(const crypto::hash& tx_prefix_hash,
+                               const vector<ring_data>& rings)
+    {
+        vector<future<bool>> checks;
+        checks.reserve(rings.size());
+
+        for (const ring_data& ring: rings)
+        {
+            const ring_data* ring_ptr = &ring;
+
+            checks.push_back(m_pool.submit([this, &tx_prefix_hash, ring_ptr]
+            {
+                return check_ring(tx_prefix_hash, *ring_ptr);
+            }));
+        }
+
+        return checks;
+    }
+
+
+    /**
+     * Wait for checks returned by submit_rings
+     * and store their results in the input order.
+     */
+    bool
+    RingVerifier::collect_results(const vector<ring_data>& rings,
+                                  vector<future<bool>>& checks,
+                                  size_t no_of_inputs,
+                                  vector<uint64_t>& results)
+    {
+        results.assign(no_of_inputs, 0);
+
+        bool all_done {true};
+
+        for (size_t i = 0; i < rings.size(); ++i)
+        {
+            try
+            {
+                results.at(rings[i].input_index) = checks[i].get() ? 1 : 0;
+            }
+            catch (const exception& e)
+            {
+                cerr << "Error checking ring of input no: "
+                     << rings[i].input_index << ": " << e.what() << endl;
+                all_done = false;
+            }
+        }
+
+        return all_done;
+    }
+
+
+    /**
+     * Check ring signature of a single input against all
+     * its ring members.
+     */
+    bool
+    RingVerifier::check_ring(const crypto::hash& tx_prefix_hash,
+                             const ring_data& ring)
+    {
+        static StageTimer& timer = StageStats::timer("check_ring_signature");
+        static StageCounter& rings_verified = StageStats::counter("rings_verified");
+        static StageCounter& rings_invalid = StageStats::counter("rings_invalid");
+
+        ScopedTimer scoped_timer {timer};
+
+        bool valid {false};
+
+        if (ring.pub_keys.size() != ring.signatures.size())
+        {
+            valid = false;
+        }
+        else if (m_point_cache.get_cache().max_cost() > 0)
+        {
+            valid = m_point_cache.check_ring_signature(tx_prefix_hash,
+                                                       ring.k_image,
+                                                       ring.pub_keys.data(),
+                                                       ring.pub_keys.size(),
+                                                       ring.signatures.data());
+        }
+        else
+        {
+            vector<const public_key*> p_output_keys;
+            p_output_keys.reserve(ring.pub_keys.size());
+
+            for (const public_key& key: ring.pub_keys)
+            {
+                p_output_keys.push_back(&key);
+            }
+
+            valid = crypto::check_ring_signature(tx_prefix_hash,
+                                                 ring.k_image,
+                                                 p_output_keys,
+                                                 ring.signatures.data());
+        }
+
+        count_stage(rings_verified);
+
+        if (!valid)
+        {
+            count_stage(rings_invalid);
+        }
+
+        return valid;
+    }
+
+
+    size_t
+    RingVerifier::no_of_threads() const
+    {
+        return m_pool.size();
+    }
+
+
+    const PointCache::cache_t&
+    RingVerifier::get_point_cache() const
+    {
+        return m_point_cache.get_cache();
+    }
+
+}
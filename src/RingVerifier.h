@@ -0,0 +1,110 @@
+#ifndef XMREG01_RINGVERIFIER_H
+#define XMREG01_RINGVERIFIER_H
+
+#include "MicroCore.h"
+#include "ThreadPool.h"
+#include "PointCache.h"
+#include "OutputKeyResolver.h"
+#include "StageStats.h"
+
+#include <vector>
+
+
+namespace xmreg
+{
+    using namespace cryptonote;
+    using namespace crypto;
+    using namespace std;
+
+
+    /**
+     * Everything needed to check a ring signature
+     * of a single txin_to_key input.
+     */
+    struct ring_data
+    {
+        size_t input_index;
+        key_image k_image;
+        vector<public_key> pub_keys;
+        vector<signature> signatures;
+    };
+
+
+    /**
+     * Verifies ring signatures of a transaction's inputs.
+     *
+     * Public keys of ring members are read from the blockchain
+     * in the calling thread, as lmdb lookups are cheap compared to
+     * the signature checks. Members of all inputs of a tx, or of
+     * all txs of a block, are read together, see OutputKeyResolver.
+     * The checks themselves are spread over a bounded pool of
+     * worker threads, one input per task.
+     *
+     * With point_cache_size > 0 (bytes), decompressed points
+     * of ring members are cached between checks, see PointCache.
+     * The cache is disabled if its check does not agree with
+     * crypto::check_ring_signature on sample rings.
+     */
+    class RingVerifier {
+
+        MicroCore& m_mcore;
+        ThreadPool m_pool;
+
+        PointCache m_point_cache;
+
+        // point cache size and hit rate for metrics
+        GaugeCallback m_point_cache_entries;
+        GaugeCallback m_point_cache_hit_ratio;
+
+    public:
+
+        RingVerifier(MicroCore& mcore,
+                     size_t no_of_threads = 0,
+                     size_t point_cache_size = 0);
+
+        bool
+        get_rings(const transaction& tx, vector<ring_data>& rings);
+
+        bool
+        get_rings(const vector<const transaction*>& txs,
+                  vector<vector<ring_data>>& rings_of_txs);
+
+        bool
+        verify_tx(const transaction& tx, vector<uint64_t>& results);
+
+        bool
+        verify_rings(const crypto::hash& tx_prefix_hash,
+                     const vector<ring_data>& rings,
+                     size_t no_of_inputs,
+                     vector<uint64_t>& results);
+
+        vector<future<bool>>
+        submit_rings(const crypto::hash& tx_prefix_hash,
+                     const vector<ring_data>& rings);
+
+        static bool
+        collect_results(const vector<ring_data>& rings,
+                        vector<future<bool>>& checks,
+                        size_t no_of_inputs,
+                        vector<uint64_t>& results);
+
+        bool
+        check_ring(const crypto::hash& tx_prefix_hash, const ring_data& ring);
+
+        size_t
+        no_of_threads() const;
+
+        const PointCache::cache_t&
+        get_point_cache() const;
+
+    private:
+
+        static bool
+        make_rings(const transaction& tx,
+                   const OutputKeyResolver& resolver,
+                   vector<ring_data>& rings);
+    };
+
+}
+
+#endif //XMREG01_RINGVERIFIER_H
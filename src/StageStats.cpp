@@ -0,0 +1,562 @@
+#include "StageStats.h"
+
+#include "../ext/format.h"
+
+#include <cctype>
+
+
+namespace xmreg
+{
+
+    namespace
+    {
+        // Prometheus metric name, e.g., "find_output_tx.index_hits"
+        // gives "rings_find_output_tx_index_hits". Names already
+        // starting with "rings_", e.g., "rings_verified", are
+        // not prefixed again.
+        string
+        metric_name(const string& name)
+        {
+            const string prefix {"rings_"};
+
+            string metric = name.compare(0, prefix.size(), prefix) == 0
+                            ? ""
+                            : prefix;
+
+            for (char c: name)
+            {
+                metric += isalnum(static_cast<unsigned char>(c)) ? c : '_';
+            }
+
+            return metric;
+        }
+    }
+
+
+    size_t
+    this_thread_stat_shard()
+    {
+        static atomic<size_t> next_shard {0};
+
+        // threads get shards round robin, on first use
+        static thread_local size_t shard
+                = next_shard.fetch_add(1, memory_order_relaxed)
+                  % NO_OF_STAT_SHARDS;
+
+        return shard;
+    }
+
+
+    constexpr size_t StageTimer::NO_OF_BUCKETS;
+
+
+    StageTimer::StageTimer(const string& name):
+            m_name(name)
+    {}
+
+
+    void
+    StageTimer::record(uint64_t ns)
+    {
+        size_t i {0};
+
+        while (i + 1 < NO_OF_BUCKETS && (ns >> (i + 1)) > 0)
+        {
+            ++i;
+        }
+
+        shard& s = m_shards[this_thread_stat_shard()];
+
+        s.buckets[i].fetch_add(1, memory_order_relaxed);
+
+        s.count.fetch_add(1, memory_order_relaxed);
+        s.total_ns.fetch_add(ns, memory_order_relaxed);
+
+        uint64_t max_ns = m_max_ns.load(memory_order_relaxed);
+
+        while (ns > max_ns
+               && !m_max_ns.compare_exchange_weak(max_ns, ns,
+                                                  memory_order_relaxed))
+        {}
+    }
+
+
+    const string&
+    StageTimer::name() const
+    {
+        return m_name;
+    }
+
+
+    uint64_t
+    StageTimer::count() const
+    {
+        uint64_t total {0};
+
+        for (const shard& s: m_shards)
+        {
+            total += s.count.load(memory_order_relaxed);
+        }
+
+        return total;
+    }
+
+
+    uint64_t
+    StageTimer::total_ns() const
+    {
+        uint64_t total {0};
+
+        for (const shard& s: m_shards)
+        {
+            total += s.total_ns.load(memory_order_relaxed);
+        }
+
+        return total;
+    }
+
+
+    uint64_t
+    StageTimer::max_ns() const
+    {
+        return m_max_ns.load(memory_order_relaxed);
+    }
+
+
+    uint64_t
+    StageTimer::bucket(size_t i) const
+    {
+        uint64_t total {0};
+
+        for (const shard& s: m_shards)
+        {
+            total += s.buckets[i].load(memory_order_relaxed);
+        }
+
+        return total;
+    }
+
+
+    uint64_t
+    StageTimer::percentile_ns(double q) const
+    {
+        uint64_t total = count();
+
+        if (total == 0)
+        {
+            return 0;
+        }
+
+        uint64_t rank = static_cast<uint64_t>(q * total);
+        uint64_t seen {0};
+
+        for (size_t i = 0; i < NO_OF_BUCKETS; ++i)
+        {
+            seen += bucket(i);
+
+            if (seen > rank)
+            {
+                // upper bound of the bucket, but not above the max
+                return std::min(max_ns(), (uint64_t {2} << i) - 1);
+            }
+        }
+
+        return max_ns();
+    }
+
+
+
+    StageCounter::StageCounter(const string& name):
+            m_name(name)
+    {}
+
+
+    void
+    StageCounter::add(uint64_t n)
+    {
+        m_shards[this_thread_stat_shard()].value.fetch_add(
+                n, memory_order_relaxed);
+    }
+
+
+    const string&
+    StageCounter::name() const
+    {
+        return m_name;
+    }
+
+
+    uint64_t
+    StageCounter::value() const
+    {
+        uint64_t total {0};
+
+        for (const shard& s: m_shards)
+        {
+            total += s.value.load(memory_order_relaxed);
+        }
+
+        return total;
+    }
+
+
+
+    StageGauge::StageGauge(const string& name):
+            m_name(name)
+    {}
+
+
+    void
+    StageGauge::set(int64_t value)
+    {
+        m_value.store(value, memory_order_relaxed);
+    }
+
+
+    const string&
+    StageGauge::name() const
+    {
+        return m_name;
+    }
+
+
+    int64_t
+    StageGauge::value() const
+    {
+        return m_value.load(memory_order_relaxed);
+    }
+
+
+
+    GaugeCallback::GaugeCallback(const string& name,
+                                 function<double()> get_value):
+            m_name(name), m_get_value(std::move(get_value))
+    {
+        StageStats& stats = StageStats::instance();
+
+        lock_guard<mutex> lock(stats.m_mutex);
+
+        stats.m_gauge_callbacks[m_name] = this;
+    }
+
+
+    const string&
+    GaugeCallback::name() const
+    {
+        return m_name;
+    }
+
+
+    double
+    GaugeCallback::value() const
+    {
+        return m_get_value();
+    }
+
+
+    GaugeCallback::~GaugeCallback()
+    {
+        StageStats& stats = StageStats::instance();
+
+        lock_guard<mutex> lock(stats.m_mutex);
+
+        auto it = stats.m_gauge_callbacks.find(m_name);
+
+        // could had been replaced by a newer one
+        if (it != stats.m_gauge_callbacks.end() && it->second == this)
+        {
+            stats.m_gauge_callbacks.erase(it);
+        }
+    }
+
+
+
+    atomic<bool> StageStats::s_enabled {false};
+
+
+    StageStats&
+    StageStats::instance()
+    {
+        // never destroyed, so that timers can be used
+        // by static objects' destructors too
+        static StageStats* stats = new StageStats();
+        return *stats;
+    }
+
+
+    StageTimer&
+    StageStats::timer(const string& name)
+    {
+        StageStats& stats = instance();
+
+        lock_guard<mutex> lock(stats.m_mutex);
+
+        unique_ptr<StageTimer>& timer = stats.m_timers[name];
+
+        if (!timer)
+        {
+            timer.reset(new StageTimer(name));
+        }
+
+        return *timer;
+    }
+
+
+    StageCounter&
+    StageStats::counter(const string& name)
+    {
+        StageStats& stats = instance();
+
+        lock_guard<mutex> lock(stats.m_mutex);
+
+        unique_ptr<StageCounter>& counter = stats.m_counters[name];
+
+        if (!counter)
+        {
+            counter.reset(new StageCounter(name));
+        }
+
+        return *counter;
+    }
+
+
+    StageGauge&
+    StageStats::gauge(const string& name)
+    {
+        StageStats& stats = instance();
+
+        lock_guard<mutex> lock(stats.m_mutex);
+
+        unique_ptr<StageGauge>& gauge = stats.m_gauges[name];
+
+        if (!gauge)
+        {
+            gauge.reset(new StageGauge(name));
+        }
+
+        return *gauge;
+    }
+
+
+    void
+    StageStats::set_enabled(bool enabled)
+    {
+        s_enabled = enabled;
+    }
+
+
+    /**
+     * Table with a row for each timer that was
+     * used, followed by counters and gauges.
+     */
+    void
+    StageStats::print_summary(ostream& os)
+    {
+        StageStats& stats = instance();
+
+        lock_guard<mutex> lock(stats.m_mutex);
+
+        fmt::MemoryWriter w;
+
+        w.write("{:<28} {:>10} {:>12} {:>10} {:>10} {:>10} {:>10} {:>10}\n",
+                "stage", "count", "total ms", "mean us",
+                "p50 us", "p90 us", "p99 us", "max us");
+
+        for (const auto& kv: stats.m_timers)
+        {
+            const StageTimer& t = *kv.second;
+
+            if (t.count() == 0)
+            {
+                continue;
+            }
+
+            w.write("{:<28} {:>10} {:>12.3f} {:>10.1f} {:>10.1f} {:>10.1f} {:>10.1f} {:>10.1f}\n",
+                    t.name(), t.count(), t.total_ns() / 1e6,
+                    t.total_ns() / 1e3 / t.count(),
+                    t.percentile_ns(0.5) / 1e3, t.percentile_ns(0.9) / 1e3,
+                    t.percentile_ns(0.99) / 1e3, t.max_ns() / 1e3);
+        }
+
+        for (const auto& kv: stats.m_counters)
+        {
+            w.write("{:<28} {:>10}\n", kv.second->name(), kv.second->value());
+        }
+
+        for (const auto& kv: stats.m_gauges)
+        {
+            w.write("{:<28} {:>10}\n", kv.second->name(), kv.second->value());
+        }
+
+        for (const auto& kv: stats.m_gauge_callbacks)
+        {
+            w.write("{:<28} {:>10.3f}\n", kv.first, kv.second->value());
+        }
+
+        os << w.str();
+    }
+
+
+    /**
+     * All timers with their histograms, and counters, as json.
+     *
+     * Histogram buckets are given by their upper bound in ns,
+     * and only non empty buckets are written.
+     */
+    void
+    StageStats::write_json(ostream& os)
+    {
+        StageStats& stats = instance();
+
+        lock_guard<mutex> lock(stats.m_mutex);
+
+        fmt::MemoryWriter w;
+
+        w << "{\n  \"timers\": [";
+
+        bool first {true};
+
+        for (const auto& kv: stats.m_timers)
+        {
+            const StageTimer& t = *kv.second;
+
+            w.write("{}\n    {{\"name\": \"{}\", \"count\": {}, \"total_ns\": {}, "
+                    "\"max_ns\": {}, \"p50_ns\": {}, \"p90_ns\": {}, \"p99_ns\": {}, "
+                    "\"buckets\": [",
+                    first ? "" : ",", t.name(), t.count(), t.total_ns(),
+                    t.max_ns(), t.percentile_ns(0.5), t.percentile_ns(0.9),
+                    t.percentile_ns(0.99));
+
+            bool first_bucket {true};
+
+            for (size_t i = 0; i < StageTimer::NO_OF_BUCKETS; ++i)
+            {
+                if (t.bucket(i) == 0)
+                {
+                    continue;
+                }
+
+                w.write("{}{{\"le_ns\": {}, \"count\": {}}}",
+                        first_bucket ? "" : ", ",
+                        (uint64_t {2} << i) - 1, t.bucket(i));
+
+                first_bucket = false;
+            }
+
+            w << "]}";
+
+            first = false;
+        }
+
+        w << "\n  ],\n  \"counters\": {";
+
+        first = true;
+
+        for (const auto& kv: stats.m_counters)
+        {
+            w.write("{}\n    \"{}\": {}", first ? "" : ",",
+                    kv.second->name(), kv.second->value());
+
+            first = false;
+        }
+
+        w << "\n  },\n  \"gauges\": {";
+
+        first = true;
+
+        for (const auto& kv: stats.m_gauges)
+        {
+            w.write("{}\n    \"{}\": {}", first ? "" : ",",
+                    kv.second->name(), kv.second->value());
+
+            first = false;
+        }
+
+        for (const auto& kv: stats.m_gauge_callbacks)
+        {
+            w.write("{}\n    \"{}\": {}", first ? "" : ",",
+                    kv.first, kv.second->value());
+
+            first = false;
+        }
+
+        w << "\n  }\n}\n";
+
+        os << w.str();
+    }
+
+
+    /**
+     * All metrics in Prometheus text exposition format.
+     *
+     * Timers are written as histograms in seconds, with
+     * buckets from about 1 us to 34 s. Names get "rings_" prefix,
+     * and counters "_total" suffix.
+     */
+    void
+    StageStats::write_prometheus(ostream& os)
+    {
+        // timer buckets exported, see StageTimer
+        constexpr size_t FIRST_BUCKET {9};
+        constexpr size_t LAST_BUCKET {34};
+
+        StageStats& stats = instance();
+
+        lock_guard<mutex> lock(stats.m_mutex);
+
+        fmt::MemoryWriter w;
+
+        for (const auto& kv: stats.m_timers)
+        {
+            const StageTimer& t = *kv.second;
+
+            string name = metric_name(t.name()) + "_seconds";
+
+            w.write("# TYPE {} histogram\n", name);
+
+            uint64_t cumulative {0};
+
+            for (size_t i = 0; i < StageTimer::NO_OF_BUCKETS; ++i)
+            {
+                cumulative += t.bucket(i);
+
+                if (i >= FIRST_BUCKET && i <= LAST_BUCKET)
+                {
+                    w.write("{}_bucket{{le=\"{:.9g}\"}} {}\n", name,
+                            (uint64_t {2} << i) / 1e9, cumulative);
+                }
+            }
+
+            w.write("{}_bucket{{le=\"+Inf\"}} {}\n", name, cumulative);
+            w.write("{}_sum {:.9f}\n", name, t.total_ns() / 1e9);
+            w.write("{}_count {}\n", name, cumulative);
+        }
+
+        for (const auto& kv: stats.m_counters)
+        {
+            string name = metric_name(kv.second->name()) + "_total";
+
+            w.write("# TYPE {} counter\n{} {}\n",
+                    name, name, kv.second->value());
+        }
+
+        for (const auto& kv: stats.m_gauges)
+        {
+            string name = metric_name(kv.second->name());
+
+            w.write("# TYPE {} gauge\n{} {}\n",
+                    name, name, kv.second->value());
+        }
+
+        for (const auto& kv: stats.m_gauge_callbacks)
+        {
+            string name = metric_name(kv.first);
+
+            w.write("# TYPE {} gauge\n{} {:.9g}\n",
+                    name, name, kv.second->value());
+        }
+
+        os << w.str();
+    }
+
+}
@@ -0,0 +1,290 @@
+#ifndef XMREG01_STAGESTATS_H
+#define XMREG01_STAGESTATS_H
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <string>
+
+
+namespace xmreg
+{
+    using namespace std;
+
+
+    // timers and counters are split into this many shards,
+    // each thread updating its own one, so that worker threads
+    // do not fight over the same cache lines.
+    constexpr size_t NO_OF_STAT_SHARDS {16};
+
+    // shards are padded rather than alignas(64), as
+    // new does not honour extended alignment before c++17
+    constexpr size_t STAT_CACHE_LINE {64};
+
+    size_t
+    this_thread_stat_shard();
+
+
+    /**
+     * Latency histogram of one stage, e.g., get_tx.
+     *
+     * Bucket i counts calls that took from 2^i to 2^(i+1) ns,
+     * so percentiles are accurate to a factor of two.
+     */
+    class StageTimer {
+
+    public:
+
+        static constexpr size_t NO_OF_BUCKETS {48};
+
+    private:
+
+        struct shard
+        {
+            atomic<uint64_t> count {0};
+            atomic<uint64_t> total_ns {0};
+            array<atomic<uint64_t>, NO_OF_BUCKETS> buckets {};
+            char padding[STAT_CACHE_LINE];
+        };
+
+        string m_name;
+
+        array<shard, NO_OF_STAT_SHARDS> m_shards;
+
+        atomic<uint64_t> m_max_ns {0};
+
+    public:
+
+        explicit StageTimer(const string& name);
+
+        void
+        record(uint64_t ns);
+
+        const string&
+        name() const;
+
+        uint64_t
+        count() const;
+
+        uint64_t
+        total_ns() const;
+
+        uint64_t
+        max_ns() const;
+
+        uint64_t
+        bucket(size_t i) const;
+
+        // upper bound of the bucket holding the q-th quantile
+        uint64_t
+        percentile_ns(double q) const;
+    };
+
+
+    class StageCounter {
+
+        struct shard
+        {
+            atomic<uint64_t> value {0};
+            char padding[STAT_CACHE_LINE - sizeof(atomic<uint64_t>)];
+        };
+
+        string m_name;
+
+        array<shard, NO_OF_STAT_SHARDS> m_shards;
+
+    public:
+
+        explicit StageCounter(const string& name);
+
+        void
+        add(uint64_t n = 1);
+
+        const string&
+        name() const;
+
+        uint64_t
+        value() const;
+    };
+
+
+    /**
+     * Value that goes up and down, e.g., queue depth
+     */
+    class StageGauge {
+
+        string m_name;
+
+        atomic<int64_t> m_value {0};
+
+    public:
+
+        explicit StageGauge(const string& name);
+
+        void
+        set(int64_t value);
+
+        const string&
+        name() const;
+
+        int64_t
+        value() const;
+    };
+
+
+    /**
+     * Gauge whose value is read from get_value when stats
+     * are reported, e.g., a cache's hit rate. It is registered
+     * for as long as this object lives, so it should be a member
+     * declared after everything get_value uses.
+     *
+     * If two objects register the same name, the newer one
+     * is reported.
+     */
+    class GaugeCallback {
+
+        string m_name;
+
+        function<double()> m_get_value;
+
+    public:
+
+        GaugeCallback(const string& name, function<double()> get_value);
+
+        GaugeCallback(const GaugeCallback&) = delete;
+        GaugeCallback& operator=(const GaugeCallback&) = delete;
+
+        const string&
+        name() const;
+
+        double
+        value() const;
+
+        ~GaugeCallback();
+    };
+
+
+    /**
+     * Registry of all stage timers, counters and gauges.
+     *
+     * Timers, counters and gauges are created on first use and
+     * live until the program ends, so call sites can keep
+     * references in function local statics:
+     *
+     *   static StageTimer& timer = StageStats::timer("get_tx");
+     *   ScopedTimer t {timer};
+     *
+     * Nothing is recorded unless enabled with set_enabled(true).
+     */
+    class StageStats {
+
+        mutex m_mutex;
+
+        // ordered by name, for the reports
+        map<string, unique_ptr<StageTimer>> m_timers;
+        map<string, unique_ptr<StageCounter>> m_counters;
+        map<string, unique_ptr<StageGauge>> m_gauges;
+        map<string, const GaugeCallback*> m_gauge_callbacks;
+
+        static atomic<bool> s_enabled;
+
+        friend class GaugeCallback;
+
+    public:
+
+        static StageTimer&
+        timer(const string& name);
+
+        static StageCounter&
+        counter(const string& name);
+
+        static StageGauge&
+        gauge(const string& name);
+
+        static void
+        set_enabled(bool enabled);
+
+        static bool
+        is_enabled()
+        {
+            return s_enabled.load(memory_order_relaxed);
+        }
+
+        static void
+        print_summary(ostream& os);
+
+        static void
+        write_json(ostream& os);
+
+        static void
+        write_prometheus(ostream& os);
+
+    private:
+
+        static StageStats&
+        instance();
+    };
+
+
+    /**
+     * Records time from construction to destruction
+     * in the given timer, if stats are enabled.
+     */
+    class ScopedTimer {
+
+        StageTimer* m_timer;
+
+        chrono::steady_clock::time_point m_start;
+
+    public:
+
+        explicit ScopedTimer(StageTimer& timer):
+                m_timer(StageStats::is_enabled() ? &timer : nullptr)
+        {
+            if (m_timer)
+            {
+                m_start = chrono::steady_clock::now();
+            }
+        }
+
+        ScopedTimer(const ScopedTimer&) = delete;
+        ScopedTimer& operator=(const ScopedTimer&) = delete;
+
+        ~ScopedTimer()
+        {
+            if (m_timer)
+            {
+                m_timer->record(chrono::duration_cast<chrono::nanoseconds>(
+                        chrono::steady_clock::now() - m_start).count());
+            }
+        }
+    };
+
+
+    inline void
+    count_stage(StageCounter& counter, uint64_t n = 1)
+    {
+        if (StageStats::is_enabled())
+        {
+            counter.add(n);
+        }
+    }
+
+
+    inline void
+    set_gauge(StageGauge& gauge, int64_t value)
+    {
+        if (StageStats::is_enabled())
+        {
+            gauge.set(value);
+        }
+    }
+
+}
+
+#endif //XMREG01_STAGESTATS_H
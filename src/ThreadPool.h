@@ -0,0 +1,149 @@
+#ifndef XMREG01_THREADPOOL_H
+#define XMREG01_THREADPOOL_H
+
+#include <vector>
+#include <queue>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <future>
+#include <functional>
+#include <memory>
+#include <stdexcept>
+
+
+namespace xmreg
+{
+    using namespace std;
+
+    /**
+     * Fixed size pool of worker threads.
+     *
+     * Tasks are queued with submit() and picked up
+     * by the first idle worker. The number of threads
+     * is bounded by the value given in the constructor,
+     * or by the number of hardware threads if 0 is given.
+     */
+    class ThreadPool {
+
+        vector<thread> m_workers;
+        queue<function<void()>> m_tasks;
+
+        mutex m_mutex;
+        condition_variable m_cv;
+
+        bool m_stop {false};
+
+    public:
+
+        explicit ThreadPool(size_t no_of_threads = 0)
+        {
+            if (no_of_threads == 0)
+            {
+                no_of_threads = default_size();
+            }
+
+            for (size_t i = 0; i < no_of_threads; ++i)
+            {
+                m_workers.emplace_back([this] { worker_loop(); });
+            }
+        }
+
+        ThreadPool(const ThreadPool&) = delete;
+        ThreadPool& operator=(const ThreadPool&) = delete;
+
+
+        /**
+         * Queue a task for execution.
+         *
+         * Returns future that will hold the result of
+         * the task, or the exception it has thrown.
+         */
+        template<typename F>
+        future<typename result_of<F()>::type>
+        submit(F f)
+        {
+            using result_type = typename result_of<F()>::type;
+
+            auto task = make_shared<packaged_task<result_type()>>(std::move(f));
+
+            future<result_type> result = task->get_future();
+
+            {
+                lock_guard<mutex> lock(m_mutex);
+
+                if (m_stop)
+                {
+                    throw runtime_error("submit on stopped ThreadPool");
+                }
+
+                m_tasks.emplace([task] { (*task)(); });
+            }
+
+            m_cv.notify_one();
+
+            return result;
+        }
+
+        size_t
+        size() const
+        {
+            return m_workers.size();
+        }
+
+        static size_t
+        default_size()
+        {
+            size_t hw_threads = thread::hardware_concurrency();
+            return hw_threads > 0 ? hw_threads : 1;
+        }
+
+        ~ThreadPool()
+        {
+            {
+                lock_guard<mutex> lock(m_mutex);
+                m_stop = true;
+            }
+
+            m_cv.notify_all();
+
+            for (thread& worker: m_workers)
+            {
+                worker.join();
+            }
+        }
+
+    private:
+
+        void
+        worker_loop()
+        {
+            while (true)
+            {
+                function<void()> task;
+
+                {
+                    unique_lock<mutex> lock(m_mutex);
+
+                    m_cv.wait(lock, [this] {
+                        return m_stop || !m_tasks.empty();
+                    });
+
+                    // finish only after all queued tasks are done
+                    if (m_stop && m_tasks.empty())
+                    {
+                        return;
+                    }
+
+                    task = std::move(m_tasks.front());
+                    m_tasks.pop();
+                }
+
+                task();
+            }
+        }
+    };
+
+}
+
+#endif //XMREG01_THREADPOOL_H
@@ -0,0 +1,256 @@
+#include "TransferCsvWriter.h"
+#include "tools.h"
+
+#include <cstring>
+#include <ctime>
+
+
+namespace xmreg
+{
+
+    constexpr size_t TransferCsvWriter::DEFAULT_BUFFER_SIZE;
+    constexpr size_t TransferCsvWriter::MAX_ROW_SIZE;
+
+
+    TransferCsvWriter::TransferCsvWriter(const string& file_path,
+                                         char delimiter,
+                                         size_t buffer_size):
+            m_buffer(std::max(buffer_size, 2 * MAX_ROW_SIZE)),
+            m_delimiter(delimiter)
+    {
+        m_file = fopen(file_path.c_str(), "wb");
+
+        if (!m_file)
+        {
+            cerr << "Cant open csv file: " << file_path << endl;
+        }
+    }
+
+
+    bool
+    TransferCsvWriter::is_open() const
+    {
+        return m_file != nullptr;
+    }
+
+
+    void
+    TransferCsvWriter::write_header()
+    {
+        const char* columns[] {"Date", "Time", "Block_no", "Tx_hash",
+                               "Out_idx", "Amount"};
+
+        for (size_t i = 0; i < 6; ++i)
+        {
+            if (i > 0)
+            {
+                append(m_delimiter);
+            }
+
+            append(columns[i], strlen(columns[i]));
+        }
+
+        append('\n');
+    }
+
+
+    void
+    TransferCsvWriter::write(const transfer_details& td)
+    {
+        // a whole row fits in the buffer after this
+        if (m_buffer.size() - m_pos < MAX_ROW_SIZE)
+        {
+            write_buffer();
+        }
+
+        append_date_time(td.m_block_timestamp);
+        append(m_delimiter);
+
+        append_uint(td.m_block_height);
+        append(m_delimiter);
+
+        append('<');
+        m_pos = hex_encode(&td.m_tx_hash, sizeof(crypto::hash),
+                           &m_buffer[m_pos]) - m_buffer.data();
+        append('>');
+        append(m_delimiter);
+
+        append_uint(td.m_internal_output_index);
+        append(m_delimiter);
+
+        append_money(td.amount());
+        append('\n');
+    }
+
+
+    /**
+     * Write buffered rows to the file, and flush it
+     */
+    bool
+    TransferCsvWriter::flush()
+    {
+        write_buffer();
+
+        if (m_file && m_ok && fflush(m_file) != 0)
+        {
+            cerr << "Error writing csv file" << endl;
+            m_ok = false;
+        }
+
+        return m_file != nullptr && m_ok;
+    }
+
+
+    /**
+     * Flush and close the file. Returns false if
+     * any write, or closing the file, failed.
+     */
+    bool
+    TransferCsvWriter::close()
+    {
+        if (!m_file)
+        {
+            return false;
+        }
+
+        flush();
+
+        if (fclose(m_file) != 0 && m_ok)
+        {
+            cerr << "Error closing csv file" << endl;
+            m_ok = false;
+        }
+
+        m_file = nullptr;
+
+        return m_ok;
+    }
+
+
+    TransferCsvWriter::~TransferCsvWriter()
+    {
+        if (m_file)
+        {
+            close();
+        }
+    }
+
+
+    /**
+     * Write buffered rows to the file, without flushing
+     * it. After an error, rows are dropped.
+     */
+    void
+    TransferCsvWriter::write_buffer()
+    {
+        if (m_file && m_ok && m_pos > 0
+            && fwrite(m_buffer.data(), 1, m_pos, m_file) != m_pos)
+        {
+            cerr << "Error writing csv file" << endl;
+            m_ok = false;
+        }
+
+        m_pos = 0;
+    }
+
+
+    void
+    TransferCsvWriter::append(const char* str, size_t len)
+    {
+        if (m_buffer.size() - m_pos < len)
+        {
+            write_buffer();
+        }
+
+        memcpy(&m_buffer[m_pos], str, len);
+        m_pos += len;
+    }
+
+
+    void
+    TransferCsvWriter::append(char c)
+    {
+        if (m_pos == m_buffer.size())
+        {
+            write_buffer();
+        }
+
+        m_buffer[m_pos++] = c;
+    }
+
+
+    void
+    TransferCsvWriter::append_uint(uint64_t value)
+    {
+        char digits[20];
+        size_t n {0};
+
+        do
+        {
+            digits[n++] = static_cast<char>('0' + value % 10);
+            value /= 10;
+        }
+        while (value > 0);
+
+        while (n > 0)
+        {
+            append(digits[--n]);
+        }
+    }
+
+
+    /**
+     * Same format as cryptonote::print_money,
+     * i.e., 12 decimal places.
+     */
+    void
+    TransferCsvWriter::append_money(uint64_t amount)
+    {
+        const uint64_t COIN {1000000000000ull};
+
+        append_uint(amount / COIN);
+        append('.');
+
+        uint64_t fraction = amount % COIN;
+
+        char digits[12];
+
+        for (size_t i = 12; i > 0; --i)
+        {
+            digits[i - 1] = static_cast<char>('0' + fraction % 10);
+            fraction /= 10;
+        }
+
+        append(digits, 12);
+    }
+
+
+    /**
+     * Date and time columns, as timestamp_to_str with
+     * "%F" and "%T" formats. Only formatted when
+     * timestamp changes.
+     */
+    void
+    TransferCsvWriter::append_date_time(uint64_t timestamp)
+    {
+        if (!m_has_timestamp || timestamp != m_last_timestamp)
+        {
+            time_t t = static_cast<time_t>(timestamp);
+
+            tm tm_buf;
+            localtime_r(&t, &tm_buf);
+
+            char format[] = "%F %T";
+            format[2] = m_delimiter;
+
+            m_date_time_len = strftime(m_date_time, sizeof(m_date_time),
+                                       format, &tm_buf);
+
+            m_last_timestamp = timestamp;
+            m_has_timestamp = true;
+        }
+
+        append(m_date_time, m_date_time_len);
+    }
+
+}
@@ -0,0 +1,106 @@
+#ifndef XMREG01_TRANSFERCSVWRITER_H
+#define XMREG01_TRANSFERCSVWRITER_H
+
+#include "tx_details.h"
+
+#include <cstdio>
+#include <string>
+#include <vector>
+
+
+namespace xmreg
+{
+    using namespace cryptonote;
+    using namespace crypto;
+    using namespace std;
+
+
+    /**
+     * Fast csv export of transfer_details.
+     *
+     * Writes the same columns as the csv::ofstream operator<<
+     * for transfer_details (date, time, block height, tx hash,
+     * output index, amount), but formats the fields directly into
+     * one large, reused output buffer, without temporary strings.
+     *
+     * Formatted date and time are cached per block timestamp,
+     * as consecutive rows usually come from the same block.
+     *
+     * Write errors are sticky: once a write fails, flush() and
+     * close() return false, so a full disk is not missed.
+     */
+    class TransferCsvWriter {
+
+        FILE* m_file {nullptr};
+
+        // false after the first failed write, so that
+        // a truncated file is reported by flush() and close()
+        bool m_ok {true};
+
+        vector<char> m_buffer;
+        size_t m_pos {0};
+
+        char m_delimiter;
+
+        // cached date and time columns of the last timestamp
+        uint64_t m_last_timestamp {0};
+        bool m_has_timestamp {false};
+        char m_date_time[64];
+        size_t m_date_time_len {0};
+
+    public:
+
+        static constexpr size_t DEFAULT_BUFFER_SIZE {4 * 1024 * 1024};
+
+        explicit TransferCsvWriter(const string& file_path,
+                                   char delimiter = ',',
+                                   size_t buffer_size = DEFAULT_BUFFER_SIZE);
+
+        TransferCsvWriter(const TransferCsvWriter&) = delete;
+        TransferCsvWriter& operator=(const TransferCsvWriter&) = delete;
+
+        bool
+        is_open() const;
+
+        void
+        write_header();
+
+        void
+        write(const transfer_details& td);
+
+        bool
+        flush();
+
+        bool
+        close();
+
+        ~TransferCsvWriter();
+
+    private:
+
+        // longest row: date time, 20 digit numbers,
+        // 66 chars of hash, delimiters, new line
+        static constexpr size_t MAX_ROW_SIZE {256};
+
+        void
+        write_buffer();
+
+        void
+        append(const char* str, size_t len);
+
+        void
+        append(char c);
+
+        void
+        append_uint(uint64_t value);
+
+        void
+        append_money(uint64_t amount);
+
+        void
+        append_date_time(uint64_t timestamp);
+    };
+
+}
+
+#endif //XMREG01_TRANSFERCSVWRITER_H
@@ -3,6 +3,13 @@
 //
 
 #include "tools.h"
+#include "StageStats.h"
+
+#include "common/varint.h"
+
+extern "C" {
+#include "crypto/crypto-ops.h"
+}
 
 
 
@@ -161,15 +168,106 @@ namespace xmreg
 
 
 
+    namespace
+    {
+        // "c: <" + 64 + "> r: <" + 64 + ">"
+        constexpr size_t SIG_STR_SIZE {4 + 2 * sizeof(ec_scalar)
+                                       + 6 + 2 * sizeof(ec_scalar) + 1};
+
+        size_t
+        sig_to_str(const signature& sig, char* out)
+        {
+            char* p = out;
+
+            memcpy(p, "c: <", 4);
+            p = hex_encode(&sig.c, sizeof(sig.c), p + 4);
+
+            memcpy(p, "> r: <", 6);
+            p = hex_encode(&sig.r, sizeof(sig.r), p + 6);
+
+            *p++ = '>';
+
+            return p - out;
+        }
+
+        /**
+         * Format str as fmt would format a string argument,
+         * so that format specs, e.g., width, still apply
+         */
+        void
+        format_str_ref(fmt::BasicFormatter<char>& f, const char*& format_str,
+                       fmt::StringRef str)
+        {
+            fmt::internal::Arg arg = fmt::internal::MakeValue<char>(str);
+
+            arg.type = static_cast<fmt::internal::Arg::Type>(
+                    fmt::internal::MakeValue<char>::type(str));
+
+            format_str = f.format(format_str, arg);
+        }
+
+        /**
+         * Write "<hex>" of pod into a stack buffer and
+         * pass it to fmt as a string argument
+         */
+        template <typename POD>
+        void
+        format_pod(fmt::BasicFormatter<char>& f, const char*& format_str,
+                   const POD& pod)
+        {
+            char buf[2 * sizeof(POD) + 2];
+
+            buf[0] = '<';
+            hex_encode(&pod, sizeof(POD), buf + 1);
+            buf[sizeof(buf) - 1] = '>';
+
+            format_str_ref(f, format_str, fmt::StringRef(buf, sizeof(buf)));
+        }
+
+        void
+        format_sig(fmt::BasicFormatter<char>& f, const char*& format_str,
+                   const signature& sig)
+        {
+            char buf[SIG_STR_SIZE];
+
+            format_str_ref(f, format_str,
+                           fmt::StringRef(buf, sig_to_str(sig, buf)));
+        }
+    }
+
+
+    char*
+    hex_encode(const void* data, size_t size, char* out)
+    {
+        static const char digits[] = "0123456789abcdef";
+
+        const unsigned char* bytes = static_cast<const unsigned char*>(data);
+
+        for (size_t i = 0; i < size; ++i)
+        {
+            *out++ = digits[bytes[i] >> 4];
+            *out++ = digits[bytes[i] & 0x0f];
+        }
+
+        return out;
+    }
+
+
     string
     print_sig (const signature& sig)
     {
-        stringstream ss;
+        char buf[SIG_STR_SIZE];
+
+        return string(buf, sig_to_str(sig, buf));
+    }
 
-        ss << "c: <" << epee::string_tools::pod_to_hex(sig.c) << "> "
-           << "r: <" << epee::string_tools::pod_to_hex(sig.r) << ">";
 
-        return ss.str();
+    void
+    write_sig(fmt::MemoryWriter& w, const signature& sig)
+    {
+        char buf[SIG_STR_SIZE];
+
+        w << fmt::StringRef(buf, sig_to_str(sig, buf));
     }
 
 
@@ -183,6 +281,8 @@ namespace xmreg
                        const crypto::public_key& pub_key,
                        crypto::key_image& key_img)
     {
+        static StageTimer& timer = StageStats::timer("generate_key_image");
+        ScopedTimer scoped_timer {timer};
 
         cryptonote::keypair in_ephemeral;
 
@@ -224,6 +324,83 @@ namespace xmreg
     }
 
 
+    /*
+     * Hs(derivation || output_index), the same scalar as
+     * used by crypto::derive_public_key, which does
+     * not expose it.
+     */
+    void
+    derivation_to_scalar(const crypto::key_derivation& derivation,
+                         const std::size_t output_index,
+                         crypto::ec_scalar& res)
+    {
+        struct {
+            crypto::key_derivation derivation;
+            char output_index[(sizeof(size_t) * 8 + 6) / 7];
+        } buf;
+
+        char* end = buf.output_index;
+
+        buf.derivation = derivation;
+
+        tools::write_varint(end, output_index);
+
+        crypto::hash h;
+
+        crypto::cn_fast_hash(&buf, end - reinterpret_cast<char*>(&buf), h);
+
+        memcpy(&res, &h, sizeof(res));
+
+        sc_reduce32(reinterpret_cast<unsigned char*>(&res));
+    }
+
+
+    /*
+     * Reverse of crypto::derive_public_key, i.e., recover
+     * public spend key B from output key P = Hs(D || i)G + B.
+     *
+     * This allows to match an output against any number of public
+     * spend keys sharing the same view key with a single lookup
+     * of the recovered key, instead of deriving output key
+     * for each of the spend keys.
+     */
+    bool
+    derive_spend_public_key(const crypto::key_derivation& derivation,
+                            const std::size_t output_index,
+                            const crypto::public_key& output_key,
+                            crypto::public_key& spend_key)
+    {
+        crypto::ec_scalar scalar;
+
+        ge_p3 output_point;
+        ge_p3 scalar_point;
+        ge_cached scalar_cached;
+        ge_p1p1 diff;
+        ge_p2 spend_point;
+
+        if (ge_frombytes_vartime(&output_point,
+                                 reinterpret_cast<const unsigned char*>(&output_key)) != 0)
+        {
+            return false;
+        }
+
+        derivation_to_scalar(derivation, output_index, scalar);
+
+        ge_scalarmult_base(&scalar_point,
+                           reinterpret_cast<const unsigned char*>(&scalar));
+
+        ge_p3_to_cached(&scalar_cached, &scalar_point);
+
+        ge_sub(&diff, &output_point, &scalar_cached);
+
+        ge_p1p1_to_p2(&spend_point, &diff);
+
+        ge_tobytes(reinterpret_cast<unsigned char*>(&spend_key), &spend_point);
+
+        return true;
+    }
+
+
     string
     get_default_lmdb_folder()
     {
@@ -301,3 +478,41 @@ namespace xmreg
 
 
 }
+
+
+
+namespace crypto
+{
+
+    void
+    format(fmt::BasicFormatter<char>& f, const char*& format_str,
+           const crypto::hash& value)
+    {
+        xmreg::format_pod(f, format_str, value);
+    }
+
+
+    void
+    format(fmt::BasicFormatter<char>& f, const char*& format_str,
+           const crypto::public_key& value)
+    {
+        xmreg::format_pod(f, format_str, value);
+    }
+
+
+    void
+    format(fmt::BasicFormatter<char>& f, const char*& format_str,
+           const crypto::key_image& value)
+    {
+        xmreg::format_pod(f, format_str, value);
+    }
+
+
+    void
+    format(fmt::BasicFormatter<char>& f, const char*& format_str,
+           const crypto::signature& value)
+    {
+        xmreg::format_sig(f, format_str, value);
+    }
+
+}
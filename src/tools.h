@@ -11,6 +11,7 @@
 #include "tx_details.h"
 
 #include "../ext/dateparser.h"
+#include "../ext/format.h"
 
 #include <boost/filesystem.hpp>
 #include <boost/optional.hpp>
@@ -71,6 +72,63 @@ namespace xmreg
     print_sig (const signature& sig);
 
 
+    /**
+     * Write hex of size bytes of data into out, which must have
+     * room for 2 * size chars. No terminating zero is added.
+     *
+     * Returns pointer past the last written char.
+     */
+    char*
+    hex_encode(const void* data, size_t size, char* out);
+
+
+    /**
+     * Hex of a pod, e.g., public key or hash, for
+     * writing to a stream without creating a string:
+     *
+     *   os << as_hex(tx_hash);
+     */
+    template <typename POD>
+    struct pod_hex
+    {
+        const POD& pod;
+    };
+
+    template <typename POD>
+    inline pod_hex<POD>
+    as_hex(const POD& pod)
+    {
+        return pod_hex<POD> {pod};
+    }
+
+    template <typename POD>
+    inline ostream&
+    operator<< (ostream& os, const pod_hex<POD>& h)
+    {
+        char buf[2 * sizeof(POD)];
+        hex_encode(&h.pod, sizeof(POD), buf);
+        return os.write(buf, sizeof(buf));
+    }
+
+
+    template <typename POD>
+    inline void
+    write_hex(fmt::MemoryWriter& w, const POD& pod)
+    {
+        char buf[2 * sizeof(POD)];
+        hex_encode(&pod, sizeof(POD), buf);
+        w << fmt::StringRef(buf, sizeof(buf));
+    }
+
+
+    /**
+     * Same as print_sig, but appends to w instead
+     * of returning a new string
+     */
+    void
+    write_sig(fmt::MemoryWriter& w, const signature& sig);
+
+
     string
     get_default_lmdb_folder();
 
@@ -81,6 +139,17 @@ namespace xmreg
                        const crypto::public_key& pub_key,
                        crypto::key_image& key_img);
 
+    void
+    derivation_to_scalar(const crypto::key_derivation& derivation,
+                         const std::size_t output_index,
+                         crypto::ec_scalar& res);
+
+    bool
+    derive_spend_public_key(const crypto::key_derivation& derivation,
+                            const std::size_t output_index,
+                            const crypto::public_key& output_key,
+                            crypto::public_key& spend_key);
+
     bool
     get_blockchain_path(const boost::optional<string>& bc_path,
                         bf::path& blockchain_path);
@@ -108,4 +177,31 @@ namespace xmreg
 
 }
 
+
+/**
+ * Formatters for fmt::print and fmt::MemoryWriter::write, found
+ * by argument dependent lookup. Hex is written into a stack buffer
+ * instead of going through operator<< and a temporary stream.
+ * Output is the same as of operator<<, i.e., "<hex>", and of
+ * print_sig for signatures. Format specs such as {:<70} work as for strings.
+ */
+namespace crypto
+{
+    void
+    format(fmt::BasicFormatter<char>& f, const char*& format_str,
+           const crypto::hash& value);
+
+    void
+    format(fmt::BasicFormatter<char>& f, const char*& format_str,
+           const crypto::public_key& value);
+
+    void
+    format(fmt::BasicFormatter<char>& f, const char*& format_str,
+           const crypto::key_image& value);
+
+    void
+    format(fmt::BasicFormatter<char>& f, const char*& format_str,
+           const crypto::signature& value);
+}
+
 #endif //XMREG01_TOOLS_H
@@ -13,14 +13,14 @@ namespace xmreg
     crypto::hash
     transfer_details::tx_hash() const
     {
-        return get_transaction_hash(m_tx);
+        return m_tx_hash;
     };
 
 
     uint64_t
     transfer_details::amount() const
     {
-        return m_tx.vout[m_internal_output_index].amount;
+        return m_amount;
     }
 
 
@@ -42,7 +42,7 @@ namespace xmreg
     /**
      * Get tx outputs associated with the given private view and public spend keys
      *
-     *
+     * tx hash is computed only if any of the outputs is ours.
      */
     vector<xmreg::transfer_details>
     get_belonging_outputs(const block& blk,
@@ -84,8 +84,7 @@ namespace xmreg
         if (!generate_key_derivation(pub_tx_key, private_view_key, derivation))
         {
             cerr << "Cant get dervied key for: "  << "\n"
-                 << "pub_tx_key: " << private_view_key << " and "
-                 << "prv_view_key" << private_view_key << endl;
+                 << "pub_tx_key: " << pub_tx_key << endl;
             return our_outputs;
         }
 
@@ -97,9 +96,9 @@ namespace xmreg
 
 
 
-        // sum amount of xmr sent to us
-        // in the given transaction
-        uint64_t money_transfered {0};
+        // hash of the tx, computed when
+        // the first output that is ours is found
+        crypto::hash tx_hash = null_hash;
 
         // loop through outputs in the given tx
         // to check which outputs our ours. we compare outputs'
@@ -131,10 +130,17 @@ namespace xmreg
                 // if so, then add this output to the
                 // returned vector
                 //our_outputs.push_back(tx.vout[i]);
+                if (our_outputs.empty())
+                {
+                    tx_hash = get_transaction_hash(tx);
+                }
+
                 our_outputs.push_back(
                         xmreg::transfer_details {block_height,
                                                  blk.timestamp,
-                                                 tx, i, false}
+                                                 tx_hash, i,
+                                                 tx.vout[i].amount,
+                                                 false}
                 );
             }
         }
@@ -144,10 +150,115 @@ namespace xmreg
 
 
 
+    /**
+     * Get outputs of all transactions in a block that are
+     * associated with the given private view and public spend keys
+     *
+     * txs are the block's transactions as returned by
+     * MicroCore::get_block_txs, i.e., coinbase tx first, followed
+     * by txs in the order of blk.tx_hashes.
+     *
+     * Derivations of all txs are computed first, in one pass,
+     * and only then the outputs are checked.
+     */
+    vector<xmreg::transfer_details>
+    get_belonging_outputs(const block& blk,
+                          const vector<shared_ptr<const transaction>>& txs,
+                          const secret_key& private_view_key,
+                          const public_key& public_spend_key,
+                          uint64_t block_height)
+    {
+        vector<xmreg::transfer_details> our_outputs;
+
+        if (txs.size() != blk.tx_hashes.size() + 1)
+        {
+            cerr << "Number of txs does not match block: "
+                 << block_height << endl;
+            return our_outputs;
+        }
+
+        // first pass: derivations of all txs in the block
+        vector<key_derivation> derivations(txs.size());
+        vector<bool> has_derivation(txs.size(), false);
+
+        size_t tx_i {0};
+
+        for (const shared_ptr<const transaction>& tx_ptr: txs)
+        {
+            const transaction& tx = *tx_ptr;
+
+            public_key pub_tx_key = get_tx_pub_key_from_extra(tx);
+
+            if (pub_tx_key != null_pkey && !tx.vout.empty())
+            {
+                has_derivation[tx_i] = generate_key_derivation(
+                        pub_tx_key, private_view_key, derivations[tx_i]);
+            }
+
+            ++tx_i;
+        }
+
+        // second pass: check outputs against the derivations
+        tx_i = 0;
+
+        for (const shared_ptr<const transaction>& tx_ptr: txs)
+        {
+            const transaction& tx = *tx_ptr;
+
+            if (!has_derivation[tx_i])
+            {
+                ++tx_i;
+                continue;
+            }
+
+            const crypto::hash tx_hash = tx_i == 0
+                                         ? get_transaction_hash(tx)
+                                         : blk.tx_hashes[tx_i - 1];
+
+            for (size_t i = 0; i < tx.vout.size(); ++i)
+            {
+                if (tx.vout[i].target.type() != typeid(txout_to_key))
+                {
+                    continue;
+                }
+
+                public_key pubkey;
+
+                derive_public_key(derivations[tx_i],
+                                  i,
+                                  public_spend_key,
+                                  pubkey);
+
+                const txout_to_key& tx_out_to_key
+                        = boost::get<txout_to_key>(tx.vout[i].target);
+
+                if (tx_out_to_key.key == pubkey)
+                {
+                    our_outputs.push_back(
+                            xmreg::transfer_details {block_height,
+                                                     blk.timestamp,
+                                                     tx_hash, i,
+                                                     tx.vout[i].amount,
+                                                     false});
+                }
+            }
+
+            ++tx_i;
+        }
+
+        return our_outputs;
+    }
+
+
+
     /**
      * Check if given output (specified by output_index)
      * belongs is ours based
      * on our private view key and public spend key
+     *
+     * Derivation is computed on each call. To check many
+     * outputs of the same tx, use get_tx_derivation and
+     * is_output_ours taking the derivation.
      */
     bool
     is_output_ours(const size_t& output_index,
@@ -155,30 +266,33 @@ namespace xmreg
                    const secret_key& private_view_key,
                    const public_key& public_spend_key)
     {
-        // get transaction's public key
-        public_key pub_tx_key = get_tx_pub_key_from_extra(tx);
+        key_derivation derivation;
 
-        // check if transaction has valid public key
-        // if no, then skip
-        if (pub_tx_key == null_pkey)
+        if (!get_tx_derivation(tx, private_view_key, derivation))
         {
             return false;
         }
 
-        // public transaction key is combined with our viewkey
-        // to create, so called, derived key.
-        key_derivation derivation;
+        return is_output_ours(output_index, tx, derivation, public_spend_key);
+    }
 
-        if (!generate_key_derivation(pub_tx_key, private_view_key, derivation))
-        {
-            cerr << "Cant get dervied key for: "  << "\n"
-                 << "pub_tx_key: " << pub_tx_key  << " and "
-                 << "prv_view_key" << private_view_key << endl;
 
+    /**
+     * Check if given output (specified by output_index)
+     * is ours, using already computed derivation of the tx.
+     */
+    bool
+    is_output_ours(const size_t& output_index,
+                   const transaction& tx,
+                   const key_derivation& derivation,
+                   const public_key& public_spend_key)
+    {
+        if (output_index >= tx.vout.size()
+            || tx.vout[output_index].target.type() != typeid(txout_to_key))
+        {
             return false;
         }
 
-
         // get the tx output public key
         // that normally would be generated for us,
         // if someone had sent us some xmr.
@@ -189,10 +303,8 @@ namespace xmreg
                           public_spend_key,
                           pubkey);
 
-        //cout << "\n" << tx.vout.size() << " " << output_index << endl;
-
         // get tx output public key
-        const txout_to_key tx_out_to_key
+        const txout_to_key& tx_out_to_key
                 = boost::get<txout_to_key>(tx.vout[output_index].target);
 
 
@@ -205,6 +317,39 @@ namespace xmreg
     }
 
 
+    /**
+     * Compute key derivation of a tx, i.e., combine
+     * tx public key with our private view key.
+     */
+    bool
+    get_tx_derivation(const transaction& tx,
+                      const secret_key& private_view_key,
+                      key_derivation& derivation)
+    {
+        // get transaction's public key
+        public_key pub_tx_key = get_tx_pub_key_from_extra(tx);
+
+        // check if transaction has valid public key
+        // if no, then skip
+        if (pub_tx_key == null_pkey)
+        {
+            return false;
+        }
+
+        // public transaction key is combined with our viewkey
+        // to create, so called, derived key.
+        if (!generate_key_derivation(pub_tx_key, private_view_key, derivation))
+        {
+            cerr << "Cant get dervied key for: "  << "\n"
+                 << "pub_tx_key: " << pub_tx_key << endl;
+
+            return false;
+        }
+
+        return true;
+    }
+
+
 }
 
 template<>
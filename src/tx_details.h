@@ -12,6 +12,8 @@
 #include "monero_headers.h"
 #include "tools.h"
 
+#include <memory>
+
 namespace xmreg
 {
 
@@ -20,12 +22,20 @@ namespace xmreg
     using namespace std;
 
 
+    /**
+     * Output found to be ours.
+     *
+     * Tx hash and amount are stored when the output is found,
+     * so the transaction itself is not kept, nor re-hashed
+     * each time tx_hash() is called.
+     */
     struct transfer_details
     {
         uint64_t m_block_height;
         uint64_t m_block_timestamp;
-        transaction m_tx;
+        crypto::hash m_tx_hash;
         size_t m_internal_output_index;
+        uint64_t m_amount;
         bool m_spent;
 
 
@@ -46,12 +56,30 @@ namespace xmreg
                           const public_key& public_spend_key,
                           uint64_t block_height = 0);
 
+    vector<xmreg::transfer_details>
+    get_belonging_outputs(const block& blk,
+                          const vector<shared_ptr<const transaction>>& txs,
+                          const secret_key& private_view_key,
+                          const public_key& public_spend_key,
+                          uint64_t block_height = 0);
+
     bool
     is_output_ours(const size_t& output_index,
                    const transaction& tx,
                    const secret_key& private_view_key,
                    const public_key& public_spend_key);
 
+    bool
+    is_output_ours(const size_t& output_index,
+                   const transaction& tx,
+                   const key_derivation& derivation,
+                   const public_key& public_spend_key);
+
+    bool
+    get_tx_derivation(const transaction& tx,
+                      const secret_key& private_view_key,
+                      key_derivation& derivation);
+
 }
 
 template<>